@@ -0,0 +1,34 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth prepass: positions only, no fragment shader. gl_Position must match shader.vert bit for bit.
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat3 normalMatrix;
+} ubo;
+
+#ifdef PACKED_VERTICES
+layout(push_constant) uniform MeshBounds {
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} mesh;
+
+layout(location = 0) in vec4 inPackedPosition;
+#else
+layout(location = 0) in vec3 inPosition;
+#endif
+
+layout(location = 3) in mat4 instanceModel;
+
+invariant gl_Position;
+
+void main() {
+#ifdef PACKED_VERTICES
+    vec3 inPosition = mesh.boundsMin.xyz + inPackedPosition.xyz * mesh.boundsExtent.xyz;
+#endif
+    vec4 worldPosition = ubo.model * (instanceModel * vec4(inPosition, 1.0));
+    gl_Position = ubo.proj * ubo.view * worldPosition;
+}
@@ -13,6 +13,12 @@ layout(binding = 2) uniform sampler2D texSampler;
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec3 fragPos;
 layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in uint fragMaterial;
+
+// Instance material colors (InstanceGrid::MATERIAL_COUNT entries); material 0 leaves the lighting untinted
+const vec3 materialColors[8] = vec3[](
+    vec3(1.0, 1.0, 1.0), vec3(0.9, 0.3, 0.3), vec3(0.3, 0.8, 0.3), vec3(0.3, 0.4, 0.9),
+    vec3(0.9, 0.8, 0.3), vec3(0.8, 0.4, 0.9), vec3(0.3, 0.8, 0.8), vec3(0.9, 0.6, 0.3));
 
 layout(location = 0) out vec4 outColor;
 
@@ -35,6 +41,6 @@ void main() {
     vec3 specular = specularStrength * spec * light.lightColor;
     
     // Combine results
-    vec3 result = (ambient + diffuse + specular); // * texture(texSampler, fragTexCoord).rgb;
+    vec3 result = (ambient + diffuse + specular) * materialColors[fragMaterial % 8u]; // * texture(texSampler, fragTexCoord).rgb;
     outColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -9,17 +9,52 @@ layout(binding = 0) uniform UniformBufferObject {
     mat3 normalMatrix;
 } ubo;
 
+#ifdef PACKED_VERTICES
+// PackedVertex: unorm16 position within the mesh bounds, octahedral snorm16 normal, half-float UV
+layout(push_constant) uniform MeshBounds {
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} mesh;
+
+layout(location = 0) in vec4 inPackedPosition;
+layout(location = 1) in vec2 inPackedNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
+#endif
+
+// InstanceData: placement within the scene (rotation, uniform scale, translation) and material
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in uint instanceMaterial;
+
+// The depth prepass (depth.vert) computes gl_Position with the same expression, and the color pass
+// tests its depth for equality against it
+invariant gl_Position;
 
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec3 fragPos;
 layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) flat out uint fragMaterial;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragPos = vec3(ubo.model * vec4(inPosition, 1.0));
-    fragNormal = ubo.normalMatrix * inNormal;
+#ifdef PACKED_VERTICES
+    vec3 inPosition = mesh.boundsMin.xyz + inPackedPosition.xyz * mesh.boundsExtent.xyz;
+    vec3 inNormal = octahedralDecode(inPackedNormal);
+#endif
+    vec4 worldPosition = ubo.model * (instanceModel * vec4(inPosition, 1.0));
+    gl_Position = ubo.proj * ubo.view * worldPosition;
+    fragPos = worldPosition.xyz;
+    fragNormal = ubo.normalMatrix * (mat3(instanceModel) * inNormal);
     fragTexCoord = inTexCoord;
+    fragMaterial = instanceMaterial;
 }
\ No newline at end of file
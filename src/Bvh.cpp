@@ -0,0 +1,392 @@
+#include "Bvh.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_USE_SSE 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Traversal stack: every popped node pushes at most four entries, and median splits keep the depth
+// below 16 even for 2^32 objects
+constexpr uint32_t MAX_STACK_SIZE = 256;
+
+static_assert(Bvh::LEAF_SIZE < 32, "leaf visibility is tracked in one 32-bit mask");
+
+// Lane bits of the four boxes entirely behind plane (outside) and entirely in front of it (inside).
+// The box corner farthest along the normal decides the first, the nearest corner the second.
+void classifyBoxes(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY,
+                   const float* maxZ, const glm::vec4& plane, uint32_t& outside, uint32_t& inside) {
+    const float* farX = plane.x > 0.0f ? maxX : minX;
+    const float* farY = plane.y > 0.0f ? maxY : minY;
+    const float* farZ = plane.z > 0.0f ? maxZ : minZ;
+    const float* nearX = plane.x > 0.0f ? minX : maxX;
+    const float* nearY = plane.y > 0.0f ? minY : maxY;
+    const float* nearZ = plane.z > 0.0f ? minZ : maxZ;
+#ifdef BVH_USE_SSE
+    __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+    __m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(farX)), _mm_mul_ps(ny, _mm_load_ps(farY))),
+                                    _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(farZ)), d));
+    __m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(nearX)), _mm_mul_ps(ny, _mm_load_ps(nearY))),
+                                     _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(nearZ)), d));
+    outside = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(farDistance, _mm_setzero_ps())));
+    inside = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(nearDistance, _mm_setzero_ps())));
+#else
+    outside = 0;
+    inside = 0;
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        float farDistance = plane.x * farX[lane] + plane.y * farY[lane] + (plane.z * farZ[lane] + plane.w);
+        float nearDistance = plane.x * nearX[lane] + plane.y * nearY[lane] + (plane.z * nearZ[lane] + plane.w);
+        if (farDistance < 0.0f) { outside |= 1u << lane; }
+        if (nearDistance >= 0.0f) { inside |= 1u << lane; }
+    }
+#endif
+}
+
+// Lane bits of the four spheres entirely behind plane; the arrays need not be aligned
+uint32_t spheresOutside(const float* x, const float* y, const float* z, const float* radius, const glm::vec4& plane) {
+#ifdef BVH_USE_SSE
+    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(x)),
+                                            _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(y))),
+                                 _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(z)), _mm_set1_ps(plane.w)));
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius));
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius)));
+#else
+    uint32_t outside = 0;
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        float distance = plane.x * x[lane] + plane.y * y[lane] + (plane.z * z[lane] + plane.w);
+        if (distance < -radius[lane]) { outside |= 1u << lane; }
+    }
+    return outside;
+#endif
+}
+
+uint32_t lowestSetBit(uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+void appendRange(std::vector<BvhRange>& ranges, uint32_t maxRanges, uint32_t first, uint32_t count, BvhCullStats& stats) {
+    stats.visible += count;
+    if (!ranges.empty()) {
+        BvhRange& last = ranges.back();
+        uint32_t lastEnd = last.first + last.count;
+        if (lastEnd == first || ranges.size() >= maxRanges) {
+            // Out of ranges: the objects in the gap are drawn although they were culled
+            stats.drawn += first + count - lastEnd;
+            last.count = first + count - last.first;
+            return;
+        }
+    }
+    ranges.push_back({first, count});
+    stats.drawn += count;
+}
+
+} // namespace
+
+ObjectBounds ObjectBounds::fromTransform(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+    // Extent of the transformed box along each world axis
+    glm::mat3 linear(model);
+    glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtent = absolute * extent;
+    float scale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+
+    ObjectBounds bounds;
+    bounds.min = worldCenter - worldExtent;
+    bounds.max = worldCenter + worldExtent;
+    bounds.center = worldCenter;
+    bounds.radius = glm::length(extent) * scale;
+    return bounds;
+}
+
+uint32_t Bvh::countNodes(uint32_t count) {
+    if (count <= LEAF_SIZE) { return 0; }
+    uint32_t left = count / 2, right = count - left;
+    return 1 + countNodes(left / 2) + countNodes(left - left / 2) + countNodes(right / 2) + countNodes(right - right / 2);
+}
+
+void Bvh::build(const std::vector<ObjectBounds>& objects, uint32_t threadCount) {
+    TRACE_SCOPE("Bvh::build");
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+    uint32_t count = static_cast<uint32_t>(objects.size());
+    nodes.clear();
+    subtrees.clear();
+    topNodes.clear();
+    objectOrder.resize(count);
+    if (count == 0) {
+        gatherBounds(objects, ParallelTarget{nullptr, threadCount});
+        return;
+    }
+
+    std::vector<BuildItem> items(count);
+    parallelFor(count, 64 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) { items[i] = {(objects[i].min + objects[i].max) * 0.5f, i}; }
+    }, threadCount);
+
+    // The layout is fixed by the object count, so every node's index is known before it is built
+    nodes.assign(std::max(1u, countNodes(count)), Node{});
+    if (count <= LEAF_SIZE) {
+        // Too few objects to split: a root with a single leaf
+        nodes[0].firstObject[0] = 0;
+        nodes[0].objectCount[0] = count;
+        nodes[0].childNode[0] = LEAF_CHILD;
+        nodes[0].childCount = 1;
+        topNodes.push_back(0);
+    } else {
+        // Enough subtrees to keep every thread busy, unless that would make them tiny
+        uint32_t subtreeDepth = 0;
+        while ((1ull << (2 * subtreeDepth)) < 4ull * threadCount && (count >> (2 * subtreeDepth)) > MIN_SUBTREE_OBJECTS) {
+            subtreeDepth++;
+        }
+        buildTop(0, 0, count, items, 0, subtreeDepth);
+        parallelFor(static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                buildSubtree(subtrees[i].root, subtrees[i].firstObject, subtrees[i].objectCount, items);
+            }
+        }, threadCount);
+    }
+
+    for (uint32_t i = 0; i < count; i++) { objectOrder[i] = items[i].object; }
+    gatherBounds(objects, ParallelTarget{nullptr, threadCount});
+    refitNodes(ParallelTarget{nullptr, threadCount});
+}
+
+void Bvh::refit(const std::vector<ObjectBounds>& objects, uint32_t threadCount) {
+    refit(objects, ParallelTarget{nullptr, threadCount});
+}
+
+void Bvh::refit(const std::vector<ObjectBounds>& objects, WorkerPool& workers) {
+    refit(objects, ParallelTarget{&workers, 0});
+}
+
+void Bvh::refit(const std::vector<ObjectBounds>& objects, const ParallelTarget& target) {
+    TRACE_SCOPE("Bvh::refit");
+    if (objects.size() != objectOrder.size()) { throw std::runtime_error("BVH refit with a different object count!"); }
+    gatherBounds(objects, target);
+    refitNodes(target);
+}
+
+void Bvh::splitRange(uint32_t first, uint32_t count, uint32_t leftCount, std::vector<BuildItem>& items) {
+    auto begin = items.begin() + first;
+    auto end = begin + count;
+    glm::vec3 centroidMin = begin->centroid;
+    glm::vec3 centroidMax = centroidMin;
+    for (auto item = begin + 1; item != end; ++item) {
+        centroidMin = glm::min(centroidMin, item->centroid);
+        centroidMax = glm::max(centroidMax, item->centroid);
+    }
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    std::nth_element(begin, begin + leftCount, end,
+                     [axis](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+}
+
+void Bvh::splitNode(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items) {
+    // Two levels of median splits give four children of (nearly) equal size
+    uint32_t left = count / 2, right = count - left;
+    splitRange(first, count, left, items);
+    splitRange(first, left, left / 2, items);
+    splitRange(first + left, right, right / 2, items);
+
+    uint32_t partCounts[4] = {left / 2, left - left / 2, right / 2, right - right / 2};
+    Node& target = nodes[node];
+    uint32_t nextNode = node + 1;
+    uint32_t partFirst = first;
+    for (uint32_t c = 0; c < 4; c++) {
+        target.firstObject[c] = partFirst;
+        target.objectCount[c] = partCounts[c];
+        target.childNode[c] = partCounts[c] > LEAF_SIZE ? nextNode : LEAF_CHILD;
+        nextNode += countNodes(partCounts[c]);
+        partFirst += partCounts[c];
+    }
+    target.childCount = 4;
+}
+
+void Bvh::buildTop(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items,
+                   uint32_t depth, uint32_t subtreeDepth) {
+    if (depth == subtreeDepth) {
+        subtrees.push_back({node, node + countNodes(count), first, count});
+        return;
+    }
+
+    topNodes.push_back(node);
+    splitNode(node, first, count, items);
+    for (uint32_t c = 0; c < 4; c++) {
+        const Node& current = nodes[node];
+        if (current.childNode[c] != LEAF_CHILD) {
+            buildTop(current.childNode[c], current.firstObject[c], current.objectCount[c], items, depth + 1, subtreeDepth);
+        }
+    }
+}
+
+void Bvh::buildSubtree(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items) {
+    splitNode(node, first, count, items);
+    for (uint32_t c = 0; c < 4; c++) {
+        const Node& current = nodes[node];
+        if (current.childNode[c] != LEAF_CHILD) {
+            buildSubtree(current.childNode[c], current.firstObject[c], current.objectCount[c], items);
+        }
+    }
+}
+
+void Bvh::gatherBounds(const std::vector<ObjectBounds>& objects, const ParallelTarget& target) {
+    uint32_t count = static_cast<uint32_t>(objectOrder.size());
+    sortedBounds.resize(count);
+    // Leaves start at any object, not on a multiple of four, and test whole groups of four from there: the
+    // last leaf can load up to three entries past the last object, so pad by three
+    uint32_t padded = count + 3;
+    sphereX.assign(padded, 0.0f);
+    sphereY.assign(padded, 0.0f);
+    sphereZ.assign(padded, 0.0f);
+    sphereRadius.assign(padded, 0.0f);
+
+    parallelFor(target, count, 64 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const ObjectBounds& bounds = objects[objectOrder[i]];
+            sortedBounds[i] = bounds;
+            sphereX[i] = bounds.center.x;
+            sphereY[i] = bounds.center.y;
+            sphereZ[i] = bounds.center.z;
+            sphereRadius[i] = bounds.radius;
+        }
+    });
+}
+
+void Bvh::refitNode(uint32_t node) {
+    Node& target = nodes[node];
+    for (uint32_t c = 0; c < target.childCount; c++) {
+        glm::vec3 boxMin, boxMax;
+        if (target.childNode[c] == LEAF_CHILD) {
+            uint32_t first = target.firstObject[c];
+            boxMin = sortedBounds[first].min;
+            boxMax = sortedBounds[first].max;
+            for (uint32_t i = first + 1; i < first + target.objectCount[c]; i++) {
+                boxMin = glm::min(boxMin, sortedBounds[i].min);
+                boxMax = glm::max(boxMax, sortedBounds[i].max);
+            }
+        } else {
+            // Children come after their parent, so they have been refit already
+            const Node& child = nodes[target.childNode[c]];
+            boxMin = glm::vec3(child.minX[0], child.minY[0], child.minZ[0]);
+            boxMax = glm::vec3(child.maxX[0], child.maxY[0], child.maxZ[0]);
+            for (uint32_t g = 1; g < child.childCount; g++) {
+                boxMin = glm::min(boxMin, glm::vec3(child.minX[g], child.minY[g], child.minZ[g]));
+                boxMax = glm::max(boxMax, glm::vec3(child.maxX[g], child.maxY[g], child.maxZ[g]));
+            }
+        }
+        target.minX[c] = boxMin.x;
+        target.minY[c] = boxMin.y;
+        target.minZ[c] = boxMin.z;
+        target.maxX[c] = boxMax.x;
+        target.maxY[c] = boxMax.y;
+        target.maxZ[c] = boxMax.z;
+    }
+}
+
+void Bvh::refitNodes(const ParallelTarget& target) {
+    // Each subtree is a contiguous block of nodes with children after parents: walk it backwards
+    parallelFor(target, static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            for (uint32_t node = subtrees[i].end; node-- > subtrees[i].root;) { refitNode(node); }
+        }
+    });
+    for (auto node = topNodes.rbegin(); node != topNodes.rend(); ++node) { refitNode(*node); }
+}
+
+BvhCullStats Bvh::cull(const Frustum& frustum, std::vector<BvhRange>& ranges, uint32_t maxRanges) const {
+    TRACE_SCOPE("Bvh::cull");
+    ranges.clear();
+    BvhCullStats stats;
+    if (nodes.empty()) { return stats; }
+
+    // A node, or a leaf / fully visible range when node is LEAF_CHILD. planeMask holds the planes the
+    // entry still straddles; its ancestors were found entirely inside the others.
+    struct Entry {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        uint32_t planeMask;
+    };
+    Entry stack[MAX_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0, 0, 0, 0x3Fu};
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.node == LEAF_CHILD) {
+            if (entry.planeMask == 0) { appendRange(ranges, maxRanges, entry.first, entry.count, stats); }
+            else { cullLeaf(frustum, entry.planeMask, entry.first, entry.count, ranges, maxRanges, stats); }
+            continue;
+        }
+
+        const Node& node = nodes[entry.node];
+        stats.nodesVisited++;
+        uint32_t outside = 0;
+        uint32_t childPlanes[4] = {entry.planeMask, entry.planeMask, entry.planeMask, entry.planeMask};
+        for (uint32_t p = 0; p < 6; p++) {
+            if (!(entry.planeMask & (1u << p))) { continue; }
+            uint32_t planeOutside, planeInside;
+            classifyBoxes(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, frustum.planes[p],
+                          planeOutside, planeInside);
+            outside |= planeOutside;
+            for (uint32_t c = 0; c < 4; c++) {
+                if (planeInside & (1u << c)) { childPlanes[c] &= ~(1u << p); }
+            }
+        }
+
+        // Pushed last to first, so objects come out in ascending order and adjacent runs merge
+        uint32_t visible = ~outside & ((1u << node.childCount) - 1);
+        for (uint32_t c = node.childCount; c-- > 0;) {
+            if (!(visible & (1u << c))) { continue; }
+            // Entirely inside: the whole subtree is one range, without visiting it
+            uint32_t child = childPlanes[c] == 0 ? LEAF_CHILD : node.childNode[c];
+            stack[stackSize++] = {child, node.firstObject[c], node.objectCount[c], childPlanes[c]};
+        }
+    }
+
+    stats.ranges = ranges.size();
+    return stats;
+}
+
+void Bvh::cullLeaf(const Frustum& frustum, uint32_t planeMask, uint32_t first, uint32_t count,
+                   std::vector<BvhRange>& ranges, uint32_t maxRanges, BvhCullStats& stats) const {
+    // One bit per object of the leaf (at most LEAF_SIZE), so runs of visible objects are appended whole
+    uint32_t visible = 0;
+    for (uint32_t group = 0; group < count; group += 4) {
+        uint32_t i = first + group;
+        uint32_t outside = 0;
+        for (uint32_t p = 0; p < 6; p++) {
+            if (planeMask & (1u << p)) {
+                outside |= spheresOutside(&sphereX[i], &sphereY[i], &sphereZ[i], &sphereRadius[i], frustum.planes[p]);
+            }
+        }
+        visible |= (~outside & 0xFu) << group;
+    }
+    visible &= (1u << count) - 1;
+
+    while (visible != 0) {
+        uint32_t start = lowestSetBit(visible);
+        uint32_t run = lowestSetBit(~(visible >> start));
+        appendRange(ranges, maxRanges, first + start, run, stats);
+        visible &= ~(((1u << run) - 1) << start);
+    }
+}
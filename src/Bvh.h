@@ -0,0 +1,132 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "ParallelFor.h"
+
+// World bounds of one object: the box drives the hierarchy, the (usually tighter for rotated objects)
+// sphere decides the objects of partially visible leaves
+struct ObjectBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+
+    // Bounds of the local box [boundsMin, boundsMax] under model (rotation, scale and translation)
+    static ObjectBounds fromTransform(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+// Objects [first, first + count) in BVH order
+struct BvhRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct BvhCullStats {
+    // Objects that passed the frustum test
+    uint64_t visible = 0;
+    // Objects covered by the returned ranges: visible plus any culled ones swallowed when maxRanges ran out
+    uint64_t drawn = 0;
+    uint64_t nodesVisited = 0;
+    uint64_t ranges = 0;
+
+    BvhCullStats& operator+=(const BvhCullStats& other) {
+        visible += other.visible;
+        drawn += other.drawn;
+        nodesVisited += other.nodesVisited;
+        ranges += other.ranges;
+        return *this;
+    }
+};
+
+// Bounding volume hierarchy with four children per node, stored depth first in one flat array. A node
+// keeps its children's boxes as structure-of-arrays, so one SSE compare tests all four against a plane.
+// Objects are reordered so that every subtree covers a contiguous range of them: a subtree entirely
+// inside the frustum is emitted as one range without visiting it, and visible objects come out as a
+// few long runs that map directly onto instanced draws with firstInstance.
+//
+// build() splits at the centroid median along the widest axis. The top levels are split serially and
+// the subtrees below them built (and refit) in parallel; node layout depends only on the object count,
+// so the result is the same for every thread count.
+class Bvh {
+public:
+    // Leaves hold at most this many objects, tested individually against their spheres
+    static constexpr uint32_t LEAF_SIZE = 16;
+
+    void build(const std::vector<ObjectBounds>& objects, uint32_t threadCount = 0);
+    // Updates bounds after objects moved, keeping the hierarchy. objects must be in the original order
+    // and as many as were built; quality degrades as objects drift from where they were at build time.
+    void refit(const std::vector<ObjectBounds>& objects, uint32_t threadCount = 0);
+    // Same, on persistent workers for refits that run every frame
+    void refit(const std::vector<ObjectBounds>& objects, WorkerPool& workers);
+
+    // Appends the visible objects to ranges (cleared first), in ascending order with adjacent runs
+    // merged. Once maxRanges are in use, further objects extend the last range instead, which also
+    // draws the culled objects in between.
+    BvhCullStats cull(const Frustum& frustum, std::vector<BvhRange>& ranges, uint32_t maxRanges) const;
+
+    // Original index of the object at each BVH position
+    [[nodiscard]] const std::vector<uint32_t>& getObjectOrder() const { return objectOrder; }
+    [[nodiscard]] uint32_t getObjectCount() const { return static_cast<uint32_t>(objectOrder.size()); }
+    [[nodiscard]] uint32_t getNodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+
+private:
+    static constexpr uint32_t LEAF_CHILD = UINT32_MAX;
+    // Subtrees handed to threads are not split further once they are this small
+    static constexpr uint32_t MIN_SUBTREE_OBJECTS = 4096;
+
+    struct alignas(16) Node {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        // Objects under each child's subtree
+        uint32_t firstObject[4];
+        uint32_t objectCount[4];
+        // Index of an inner child node, or LEAF_CHILD
+        uint32_t childNode[4];
+        uint32_t childCount;
+    };
+
+    // Objects are partitioned by value rather than through an index array, so the median searches of a
+    // build stream through memory
+    struct BuildItem {
+        glm::vec3 centroid;
+        uint32_t object;
+    };
+
+    // A subtree built and refit by one thread; its nodes are [root, end)
+    struct Subtree {
+        uint32_t root;
+        uint32_t end;
+        uint32_t firstObject;
+        uint32_t objectCount;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> objectOrder;
+    // Object bounds in BVH order: boxes for refitting leaves, spheres split by component for SIMD tests
+    std::vector<ObjectBounds> sortedBounds;
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<Subtree> subtrees;
+    // Nodes above the subtrees, in creation (depth first) order
+    std::vector<uint32_t> topNodes;
+
+    // Inner nodes of the subtree over count objects (0 for a leaf)
+    static uint32_t countNodes(uint32_t count);
+    void splitRange(uint32_t first, uint32_t count, uint32_t leftCount, std::vector<BuildItem>& items);
+    void splitNode(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items);
+    void buildTop(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items,
+                  uint32_t depth, uint32_t subtreeDepth);
+    void buildSubtree(uint32_t node, uint32_t first, uint32_t count, std::vector<BuildItem>& items);
+    void refit(const std::vector<ObjectBounds>& objects, const ParallelTarget& target);
+    void gatherBounds(const std::vector<ObjectBounds>& objects, const ParallelTarget& target);
+    void refitNode(uint32_t node);
+    void refitNodes(const ParallelTarget& target);
+    void cullLeaf(const Frustum& frustum, uint32_t planeMask, uint32_t first, uint32_t count,
+                  std::vector<BvhRange>& ranges, uint32_t maxRanges, BvhCullStats& stats) const;
+};
+
+#endif // BVH_H
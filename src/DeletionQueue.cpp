@@ -0,0 +1,38 @@
+#include "DeletionQueue.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <vector>
+
+void DeletionQueue::push(uint64_t frame, std::function<void()> deleter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // A frame number older than one already queued is safe to delay, and keeps the queue sorted
+    lastFrame = std::max(lastFrame, frame);
+    entries.push_back({lastFrame, std::move(deleter)});
+}
+
+size_t DeletionQueue::collect(uint64_t completedFrame) {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!entries.empty() && entries.front().frame <= completedFrame) {
+            ready.push_back(std::move(entries.front().deleter));
+            entries.pop_front();
+        }
+    }
+    if (ready.empty()) { return 0; }
+
+    // Deleters run outside the lock so they may push follow-up work
+    TRACE_SCOPE("DeletionQueue::collect");
+    for (auto& deleter : ready) { deleter(); }
+    return ready.size();
+}
+
+void DeletionQueue::flush() {
+    while (collect(UINT64_MAX) > 0) {}
+}
+
+size_t DeletionQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
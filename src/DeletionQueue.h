@@ -0,0 +1,38 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Holds destruction of GPU objects back until the frame that last used them has finished, so
+// resources can be replaced or released at runtime without vkDeviceWaitIdle.
+//
+// Frames are numbered from 1 in submission order. A deleter pushed with frame N runs from the first
+// collect() whose completed frame is >= N; the owner derives that number from its per-frame fences
+// (frames on one queue complete in order). Thread safe; deleters run on the thread calling collect().
+class DeletionQueue {
+public:
+    void push(uint64_t frame, std::function<void()> deleter);
+
+    // Runs every deleter whose frame has completed and returns how many ran
+    size_t collect(uint64_t completedFrame);
+    // Runs everything regardless of frame; only valid once the device is idle
+    void flush();
+
+    [[nodiscard]] size_t pending() const;
+
+private:
+    struct Entry {
+        uint64_t frame;
+        std::function<void()> deleter;
+    };
+
+    // Kept sorted by frame: pushes never go below the last frame seen
+    std::deque<Entry> entries;
+    uint64_t lastFrame = 0;
+    mutable std::mutex mutex;
+};
+
+#endif // DELETION_QUEUE_H
@@ -0,0 +1,75 @@
+#ifndef DENSE_KEY_TABLE_H
+#define DENSE_KEY_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mixes value into hash; start from the FNV offset basis 0xcbf29ce484222325
+inline uint64_t hashCombine(uint64_t hash, uint64_t value) {
+    // 64-bit finalizer from MurmurHash3, applied per component
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return (hash ^ value) * 0x100000001b3ull;
+}
+
+// Open-addressing table from keys to dense slots (linear probing, power-of-two capacity). Slots are
+// handed out in insertion order, so the caller keeps per-slot data in plain arrays.
+template <typename Key>
+class DenseKeyTable {
+public:
+    explicit DenseKeyTable(size_t expectedKeys) {
+        size_t capacity = 16;
+        while (capacity < expectedKeys * 2) { capacity *= 2; }
+        slots.assign(capacity, EMPTY);
+        mask = capacity - 1;
+    }
+
+    // Returns the slot of key, inserting it as slot keys.size() if it is new
+    uint32_t findOrInsert(const Key& key, uint64_t hash, bool& inserted) {
+        size_t position = static_cast<size_t>(hash) & mask;
+        while (true) {
+            uint32_t slot = slots[position];
+            if (slot == EMPTY) {
+                if (keys.size() * 2 >= slots.size()) {
+                    grow();
+                    return findOrInsert(key, hash, inserted);
+                }
+                slot = static_cast<uint32_t>(keys.size());
+                slots[position] = slot;
+                keys.push_back(key);
+                hashes.push_back(hash);
+                inserted = true;
+                return slot;
+            }
+            if (hashes[slot] == hash && keys[slot] == key) {
+                inserted = false;
+                return slot;
+            }
+            position = (position + 1) & mask;
+        }
+    }
+
+    std::vector<Key> keys;
+    std::vector<uint64_t> hashes;
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<uint32_t> slots;
+    size_t mask = 0;
+
+    void grow() {
+        slots.assign(slots.size() * 2, EMPTY);
+        mask = slots.size() - 1;
+        for (uint32_t slot = 0; slot < keys.size(); slot++) {
+            size_t position = static_cast<size_t>(hashes[slot]) & mask;
+            while (slots[position] != EMPTY) { position = (position + 1) & mask; }
+            slots[position] = slot;
+        }
+    }
+};
+
+#endif // DENSE_KEY_TABLE_H
@@ -0,0 +1,141 @@
+#include "FrameBenchmark.h"
+#include "Json.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+FrameBenchmark::FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+    : warmupFrames(warmupFrames), measuredFrames(measuredFrames) {
+    samples.reserve(measuredFrames);
+}
+
+void FrameBenchmark::addFrame(const FrameTimings& timings) {
+    auto now = BenchmarkClock::now();
+
+    if (isWarmingUp()) {
+        framesSeen++;
+        // The measured span starts where the last warm-up frame ended
+        measureStart = now;
+        return;
+    }
+
+    if (isComplete()) { return; }
+
+    if (samples.empty() && warmupFrames == 0) {
+        // No warm-up: back-date the start by the first frame's own duration
+        measureStart = now - std::chrono::duration_cast<BenchmarkClock::duration>(
+            std::chrono::duration<double, std::milli>(timings.frameMs));
+    }
+
+    framesSeen++;
+    samples.push_back(timings);
+    measureEnd = now;
+}
+
+PercentileSummary FrameBenchmark::summarize(std::vector<double> values) {
+    PercentileSummary summary;
+    if (values.empty()) { return summary; }
+
+    std::sort(values.begin(), values.end());
+
+    // Nearest-rank percentile on the sorted samples
+    auto percentile = [&values](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+        return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+
+    summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    summary.min = values.front();
+    summary.p50 = percentile(50.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    summary.max = values.back();
+    return summary;
+}
+
+std::vector<double> FrameBenchmark::collect(double FrameTimings::* field) const {
+    std::vector<double> values;
+    values.reserve(samples.size());
+    for (const auto& sample : samples) { values.push_back(sample.*field); }
+    return values;
+}
+
+double FrameBenchmark::measuredSeconds() const {
+    if (samples.empty()) { return 0.0; }
+    return std::chrono::duration<double>(measureEnd - measureStart).count();
+}
+
+double FrameBenchmark::framesPerSecond() const {
+    double seconds = measuredSeconds();
+    return seconds > 0.0 ? static_cast<double>(samples.size()) / seconds : 0.0;
+}
+
+void FrameBenchmark::printSummary() const {
+    PercentileSummary frame = frameTimeSummary();
+    double seconds = measuredSeconds();
+    double fps = framesPerSecond();
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "Benchmark: " << samples.size() << " frames in " << seconds << " s (" << fps << " FPS)\n"
+              << "  frame time ms: p50 " << frame.p50 << ", p95 " << frame.p95
+              << ", p99 " << frame.p99 << ", max " << frame.max << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+static void writeSummary(std::ostream& out, const char* name, const PercentileSummary& s, bool last) {
+    out << "    \"" << name << "\": {"
+        << "\"mean\": " << s.mean << ", "
+        << "\"min\": " << s.min << ", "
+        << "\"p50\": " << s.p50 << ", "
+        << "\"p95\": " << s.p95 << ", "
+        << "\"p99\": " << s.p99 << ", "
+        << "\"max\": " << s.max << "}" << (last ? "\n" : ",\n");
+}
+
+void FrameBenchmark::writeJson(const std::string& filename, const BenchmarkInfo& info) const {
+    std::ofstream out(filename);
+    if (!out.is_open()) { throw std::runtime_error("failed to open benchmark output: " + filename); }
+
+    double seconds = measuredSeconds();
+    double fps = framesPerSecond();
+
+    out << std::setprecision(6) << std::fixed;
+    out << "{\n"
+        << "  \"device\": \"" << escapeJson(info.deviceName) << "\",\n"
+        << "  \"driverVersion\": \"" << escapeJson(info.driverVersion) << "\",\n"
+        << "  \"mode\": \"" << info.mode << "\",\n"
+        << "  \"presentMode\": \"" << info.presentMode << "\",\n"
+        << "  \"width\": " << info.width << ",\n"
+        << "  \"height\": " << info.height << ",\n"
+        << "  \"instances\": " << info.instances << ",\n"
+        << "  \"warmupFrames\": " << warmupFrames << ",\n"
+        << "  \"measuredFrames\": " << samples.size() << ",\n"
+        << "  \"totalSeconds\": " << seconds << ",\n"
+        << "  \"framesPerSecond\": " << fps << ",\n"
+        << "  \"metricsMs\": {\n";
+    writeSummary(out, "frame", summarize(collect(&FrameTimings::frameMs)), false);
+    writeSummary(out, "cpu", summarize(collect(&FrameTimings::cpuMs)), false);
+    writeSummary(out, "fenceWait", summarize(collect(&FrameTimings::fenceWaitMs)), false);
+    writeSummary(out, "acquire", summarize(collect(&FrameTimings::acquireMs)), false);
+    writeSummary(out, "record", summarize(collect(&FrameTimings::recordMs)), false);
+    writeSummary(out, "submit", summarize(collect(&FrameTimings::submitMs)), false);
+    writeSummary(out, "present", summarize(collect(&FrameTimings::presentMs)), true);
+    out << "  }";
+
+    if (!info.gpuScopes.empty()) {
+        out << ",\n  \"gpuScopesAverageMs\": {\n";
+        for (size_t i = 0; i < info.gpuScopes.size(); i++) {
+            out << "    \"" << escapeJson(info.gpuScopes[i].first) << "\": " << info.gpuScopes[i].second
+                << (i + 1 < info.gpuScopes.size() ? ",\n" : "\n");
+        }
+        out << "  }";
+    }
+
+    out << "\n}\n";
+
+    std::cout << "Benchmark results written to " << filename << std::endl;
+}
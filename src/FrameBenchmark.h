@@ -0,0 +1,83 @@
+#ifndef FRAME_BENCHMARK_H
+#define FRAME_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+inline double millisecondsBetween(BenchmarkClock::time_point start, BenchmarkClock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// CPU-side timings of a single drawFrame() call, in milliseconds
+struct FrameTimings {
+    double frameMs = 0.0;      // Whole loop iteration (event polling + drawFrame)
+    double cpuMs = 0.0;        // drawFrame() minus the time spent blocked on the in-flight fence
+    double fenceWaitMs = 0.0;  // vkWaitForFences on the frame-in-flight fence
+    double acquireMs = 0.0;    // vkAcquireNextImageKHR
+    double recordMs = 0.0;     // Command buffer recording (per-frame recording only)
+    double submitMs = 0.0;     // vkQueueSubmit
+    double presentMs = 0.0;    // vkQueuePresentKHR
+};
+
+// Describes the run so results from different machines/driver builds can be compared
+struct BenchmarkInfo {
+    std::string deviceName;
+    std::string driverVersion;
+    std::string mode;
+    std::string presentMode;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Instances drawn per frame
+    uint32_t instances = 1;
+    // Average GPU time per profiler scope (empty unless GPU profiling is enabled)
+    std::vector<std::pair<std::string, double>> gpuScopes;
+};
+
+struct PercentileSummary {
+    double mean = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+class FrameBenchmark {
+public:
+    FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+    // Frames added during warm-up are counted but not recorded
+    void addFrame(const FrameTimings& timings);
+
+    [[nodiscard]] bool isWarmingUp() const { return framesSeen < warmupFrames; }
+    [[nodiscard]] bool isComplete() const { return samples.size() >= measuredFrames; }
+    [[nodiscard]] uint32_t totalFrames() const { return warmupFrames + measuredFrames; }
+
+    [[nodiscard]] PercentileSummary frameTimeSummary() const { return summarize(collect(&FrameTimings::frameMs)); }
+    [[nodiscard]] double framesPerSecond() const;
+
+    void printSummary() const;
+    void writeJson(const std::string& filename, const BenchmarkInfo& info) const;
+
+    static PercentileSummary summarize(std::vector<double> values);
+
+private:
+    uint32_t warmupFrames;
+    uint32_t measuredFrames;
+    uint32_t framesSeen = 0;
+    std::vector<FrameTimings> samples;
+
+    // Wall-clock span of the measured frames, for throughput
+    BenchmarkClock::time_point measureStart;
+    BenchmarkClock::time_point measureEnd;
+
+    std::vector<double> collect(double FrameTimings::* field) const;
+    double measuredSeconds() const;
+};
+
+#endif // FRAME_BENCHMARK_H
@@ -0,0 +1,32 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a view volume as (normal, distance) with inward-facing unit normals
+struct Frustum {
+    // Left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    // Extracts the planes of a clip-space matrix (Gribb/Hartmann) for the [0, w] depth range GLM is
+    // configured for. Passing projection * view * model yields planes in model space.
+    static Frustum fromMatrix(const glm::mat4& matrix) {
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; r++) { rows[r] = glm::vec4(matrix[0][r], matrix[1][r], matrix[2][r], matrix[3][r]); }
+
+        Frustum frustum{{rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                         rows[3] - rows[1], rows[2], rows[3] - rows[2]}};
+        for (glm::vec4& plane : frustum.planes) { plane /= glm::length(glm::vec3(plane)); }
+        return frustum;
+    }
+
+    // Conservative: spheres near a corner may pass although they are outside
+    [[nodiscard]] bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) { return false; }
+        }
+        return true;
+    }
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,151 @@
+#include "GpuProfiler.h"
+#include "VulkanException.h"
+#include <iomanip>
+#include <iostream>
+
+void GpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t queueFamilyIndex, uint32_t slotCount) {
+    device = dev;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        std::cout << "  GPU timestamps not supported on this queue, GPU profiling disabled" << std::endl;
+        enabled = false;
+        return;
+    }
+
+    timestampPeriodNs = properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~0ULL : ((1ULL << validBits) - 1);
+    queryResults.resize(MAX_QUERIES_PER_SLOT);
+    enabled = true;
+
+    setSlotCount(slotCount);
+}
+
+void GpuProfiler::cleanup() {
+    for (auto& slot : slots) {
+        if (slot.queryPool != VK_NULL_HANDLE) { vkDestroyQueryPool(device, slot.queryPool, nullptr); }
+    }
+    slots.clear();
+    enabled = false;
+}
+
+void GpuProfiler::createQueryPool(Slot& slot) {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = MAX_QUERIES_PER_SLOT;
+
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &slot.queryPool), "failed to create timestamp query pool!");
+}
+
+void GpuProfiler::setSlotCount(uint32_t slotCount) {
+    if (!enabled) { return; }
+
+    // Slots are only ever added: command buffers of a larger, retired swapchain may still be in flight
+    // with their query pools, and the spare pools are cheap
+    while (slots.size() < slotCount) {
+        slots.emplace_back();
+        createQueryPool(slots.back());
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (!enabled) { return; }
+
+    Slot& s = slots[slot];
+    s.scopes.clear();
+    s.queryCount = 0;
+    s.depth = 0;
+    s.pendingResults = false;
+
+    vkCmdResetQueryPool(commandBuffer, s.queryPool, 0, MAX_QUERIES_PER_SLOT);
+}
+
+uint32_t GpuProfiler::timingIndexFor(const char* name, uint32_t depth) {
+    auto it = scopeIndices.find(name);
+    if (it != scopeIndices.end()) { return it->second; }
+
+    GpuScopeTiming timing;
+    timing.name = name;
+    timing.depth = depth;
+    scopeTimings.push_back(timing);
+
+    uint32_t index = static_cast<uint32_t>(scopeTimings.size() - 1);
+    scopeIndices.emplace(name, index);
+    return index;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, uint32_t slot, const char* name) {
+    if (!enabled) { return 0; }
+
+    Slot& s = slots[slot];
+    if (s.queryCount + 2 > MAX_QUERIES_PER_SLOT) { throw std::runtime_error("too many GPU profiler scopes in one command buffer!"); }
+
+    Scope scope{};
+    scope.timingIndex = timingIndexFor(name, s.depth);
+    scope.beginQuery = s.queryCount++;
+    scope.endQuery = s.queryCount++;
+    s.scopes.push_back(scope);
+    s.depth++;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, s.queryPool, scope.beginQuery);
+    return static_cast<uint32_t>(s.scopes.size() - 1);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope) {
+    if (!enabled) { return; }
+
+    Slot& s = slots[slot];
+    s.depth--;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s.queryPool, s.scopes[scope].endQuery);
+}
+
+void GpuProfiler::markSubmitted(uint32_t slot) {
+    if (!enabled) { return; }
+    slots[slot].pendingResults = slots[slot].queryCount > 0;
+}
+
+void GpuProfiler::collect(uint32_t slot) {
+    if (!enabled || !slots[slot].pendingResults) { return; }
+
+    Slot& s = slots[slot];
+    s.pendingResults = false;
+
+    // No VK_QUERY_RESULT_WAIT_BIT: the caller has already waited for the submission's fence
+    VkResult result = vkGetQueryPoolResults(device, s.queryPool, 0, s.queryCount,
+                                            s.queryCount * sizeof(uint64_t), queryResults.data(),
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_NOT_READY) { return; }
+    VK_CHECK(result, "failed to read timestamp queries!");
+
+    for (const auto& scope : s.scopes) {
+        uint64_t begin = queryResults[scope.beginQuery] & timestampMask;
+        uint64_t end = queryResults[scope.endQuery] & timestampMask;
+        uint64_t ticks = (end - begin) & timestampMask;
+
+        GpuScopeTiming& timing = scopeTimings[scope.timingIndex];
+        timing.lastMs = static_cast<double>(ticks) * timestampPeriodNs * 1e-6;
+        timing.totalMs += timing.lastMs;
+        timing.samples++;
+    }
+}
+
+void GpuProfiler::printSummary() const {
+    if (!enabled || scopeTimings.empty()) { return; }
+
+    std::cout << "GPU scopes (average ms):" << std::endl;
+    for (const auto& timing : scopeTimings) {
+        std::cout << "  " << std::string(timing.depth * 2, ' ') << timing.name << ": "
+                  << std::fixed << std::setprecision(4) << timing.averageMs()
+                  << " (" << timing.samples << " samples)" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
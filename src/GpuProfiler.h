@@ -0,0 +1,78 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Accumulated GPU time of one named scope
+struct GpuScopeTiming {
+    std::string name;
+    uint32_t depth = 0;
+    double lastMs = 0.0;
+    double totalMs = 0.0;
+    uint64_t samples = 0;
+
+    [[nodiscard]] double averageMs() const { return samples > 0 ? totalMs / static_cast<double>(samples) : 0.0; }
+};
+
+// Timestamp-query profiler. Every command buffer that is recorded with scopes owns a "slot" with its own
+// query pool. Results of a slot are read back only after the fence of its last submission has signaled,
+// so vkGetQueryPoolResults never waits on the GPU.
+class GpuProfiler {
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t slotCount);
+    void cleanup();
+
+    // Adds query pools when the number of command buffers grows (never shrinks while frames may be in flight)
+    void setSlotCount(uint32_t slotCount);
+
+    [[nodiscard]] bool isEnabled() const { return enabled; }
+
+    // Recording: beginFrame() resets the slot's queries and must be recorded outside of a render pass
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+    uint32_t beginScope(VkCommandBuffer commandBuffer, uint32_t slot, const char* name);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope);
+
+    // Submission/readback: collect() must only be called once the slot's last submission has completed
+    void markSubmitted(uint32_t slot);
+    void collect(uint32_t slot);
+
+    [[nodiscard]] const std::vector<GpuScopeTiming>& timings() const { return scopeTimings; }
+    void printSummary() const;
+
+private:
+    static constexpr uint32_t MAX_QUERIES_PER_SLOT = 128;
+
+    struct Scope {
+        uint32_t timingIndex;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct Slot {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<Scope> scopes;
+        uint32_t queryCount = 0;
+        uint32_t depth = 0;
+        bool pendingResults = false;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    bool enabled = false;
+    double timestampPeriodNs = 1.0;
+    uint64_t timestampMask = ~0ULL;
+
+    std::vector<Slot> slots;
+    std::vector<GpuScopeTiming> scopeTimings;
+    std::unordered_map<std::string, uint32_t> scopeIndices;
+    std::vector<uint64_t> queryResults;
+
+    void createQueryPool(Slot& slot);
+    uint32_t timingIndexFor(const char* name, uint32_t depth);
+};
+
+#endif // GPU_PROFILER_H
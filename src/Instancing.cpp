@@ -0,0 +1,77 @@
+#include "Instancing.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <cstddef>
+#include <glm/gtc/matrix_transform.hpp>
+
+VkVertexInputBindingDescription InstanceData::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = BINDING;
+    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> InstanceData::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(MODEL_ATTRIBUTE_COUNT + 1);
+
+    // Model matrix, one column per location
+    for (uint32_t column = 0; column < MODEL_ATTRIBUTE_COUNT; column++) {
+        attributeDescriptions[column].binding = BINDING;
+        attributeDescriptions[column].location = FIRST_LOCATION + column;
+        attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[column].offset = static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * column);
+    }
+
+    // Material index
+    attributeDescriptions[MODEL_ATTRIBUTE_COUNT].binding = BINDING;
+    attributeDescriptions[MODEL_ATTRIBUTE_COUNT].location = FIRST_LOCATION + MODEL_ATTRIBUTE_COUNT;
+    attributeDescriptions[MODEL_ATTRIBUTE_COUNT].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[MODEL_ATTRIBUTE_COUNT].offset = offsetof(InstanceData, materialIndex);
+
+    return attributeDescriptions;
+}
+
+// Integer hash (lowbias32) mapping instance indices to well-spread bits
+static uint32_t hashIndex(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float InstanceGrid::build(uint32_t count, std::vector<InstanceData>& instances, uint32_t threadCount) {
+    TRACE_SCOPE("InstanceGrid::build");
+    instances.assign(count, InstanceData{});
+    if (count <= 1) {
+        for (InstanceData& instance : instances) { instance.model = glm::mat4(1.0f); }
+        return 1.0f;
+    }
+
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+    while (static_cast<uint64_t>(side) * side * side < count) { side++; }
+    float cell = 1.0f / static_cast<float>(side);
+    float scale = cell * 0.8f;
+
+    parallelFor(count, 16 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t x = i % side, y = (i / side) % side, z = i / (side * side);
+            glm::vec3 center = (glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) + 0.5f) * cell - 0.5f;
+
+            uint32_t hash = hashIndex(i);
+            float angle = static_cast<float>(hash & 0xFFFFu) / 65536.0f * glm::radians(360.0f);
+            glm::vec3 axis = glm::normalize(glm::vec3(static_cast<float>((hash >> 16) & 0xFFu) + 1.0f,
+                                                      static_cast<float>((hash >> 24) & 0xFFu), 128.0f));
+
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+            model = glm::rotate(model, angle, axis);
+            instances[i].model = glm::scale(model, glm::vec3(scale));
+            instances[i].materialIndex = i % MATERIAL_COUNT;
+        }
+    }, threadCount);
+    return scale;
+}
@@ -0,0 +1,42 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Per-instance vertex data, read at VK_VERTEX_INPUT_RATE_INSTANCE from its own binding. The shaders
+// apply model before the frame's model matrix and transform normals with its upper 3x3, so it may only
+// hold rotation, uniform scale and translation.
+struct InstanceData {
+    glm::mat4 model;
+    // Selects a color from the palette in shader.frag
+    uint32_t materialIndex;
+    uint32_t padding[3];
+
+    // Binding and locations follow the mesh's (bindings 0-1, locations 0-2)
+    static constexpr uint32_t BINDING = 2;
+    static constexpr uint32_t FIRST_LOCATION = 3;
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    // model takes four vec4 locations, materialIndex the one after them. Depth-only passes that do not
+    // read the material can take just the first MODEL_ATTRIBUTE_COUNT entries.
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    static constexpr uint32_t MODEL_ATTRIBUTE_COUNT = 4;
+};
+
+class InstanceGrid {
+public:
+    // Materials cycled through by build(); must match the palette size in shader.frag
+    static constexpr uint32_t MATERIAL_COUNT = 8;
+
+    // Fills the unit cube [-0.5, 0.5]^3 with count instances on the smallest cubic grid that holds them,
+    // each scaled to 80% of its cell and turned by a rotation hashed from its index, so the result is the
+    // same for every thread count. Returns the instance scale (1 for a single instance, which gets the
+    // identity transform and material 0). Large counts are generated in parallel.
+    static float build(uint32_t count, std::vector<InstanceData>& instances, uint32_t threadCount = 0);
+};
+
+#endif // INSTANCING_H
@@ -0,0 +1,17 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+
+// Escapes quotes and backslashes for a JSON string literal and drops control characters, which the
+// device, scope and thread names written by the benchmark and trace output never need
+inline std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') { escaped += '\\'; }
+        if (static_cast<unsigned char>(c) >= 0x20) { escaped += c; }
+    }
+    return escaped;
+}
+
+#endif // JSON_H
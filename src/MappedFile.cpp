@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("failed to open file: " + path); }
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        release();
+        throw std::runtime_error("failed to query file size: " + path);
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0) { return; }
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr) { bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)); }
+    if (bytes == nullptr) {
+        release();
+        throw std::runtime_error("failed to map file: " + path);
+    }
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) { throw std::runtime_error("failed to open file: " + path); }
+
+    struct stat status{};
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("failed to query file size: " + path);
+    }
+    length = static_cast<size_t>(status.st_size);
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED) {
+            close(file);
+            length = 0;
+            throw std::runtime_error("failed to map file: " + path);
+        }
+        bytes = static_cast<const char*>(mapping);
+        // Parsers sweep the file front to back, so ask for aggressive read-ahead
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+    // The mapping keeps its own reference to the file
+    close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+    if (bytes != nullptr) { UnmapViewOfFile(bytes); }
+    if (mappingHandle != nullptr) { CloseHandle(mappingHandle); }
+    if (fileHandle != nullptr) { CloseHandle(fileHandle); }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (bytes != nullptr) { munmap(const_cast<char*>(bytes), length); }
+#endif
+    bytes = nullptr;
+    length = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are loaded on first touch, so parsers can start on any
+// part of the file without reading it up front. Move-only; the mapping is released on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    // Throws if the file cannot be opened or mapped. Empty files map to data() == nullptr, size() == 0.
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] const char* data() const { return bytes; }
+    [[nodiscard]] size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    void release();
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,319 @@
+#include "MemoryAllocator.h"
+#include "VulkanException.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+double toMiB(VkDeviceSize bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+void DeviceAllocator::init(VkPhysicalDevice physicalDevice, VkDevice dev) {
+    device = dev;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    pools.clear();
+    pools.resize(static_cast<size_t>(memoryProperties.memoryTypeCount) * 4);
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+        for (AllocationPool strategy : {AllocationPool::General, AllocationPool::Linear}) {
+            for (bool optimalImage : {false, true}) {
+                Pool& pool = pools[poolIndex(type, strategy, optimalImage)];
+                pool.memoryTypeIndex = type;
+                pool.strategy = strategy;
+                pool.blockSize = std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+            }
+        }
+    }
+}
+
+void DeviceAllocator::cleanup() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t leaked = 0;
+    for (auto& pool : pools) {
+        for (auto& block : pool.blocks) {
+            leaked += block.allocationCount;
+            releaseBlock(block);
+        }
+        pool.blocks.clear();
+    }
+    if (leaked > 0) { std::cerr << "DeviceAllocator: " << leaked << " allocations still alive at cleanup" << std::endl; }
+}
+
+uint32_t DeviceAllocator::poolIndex(uint32_t memoryTypeIndex, AllocationPool strategy, bool optimalImage) const {
+    return (memoryTypeIndex * 2 + (strategy == AllocationPool::Linear ? 1 : 0)) * 2 + (optimalImage ? 1 : 0);
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+Allocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                     AllocationPool strategy, bool optimalImage) {
+    uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+    uint32_t index = poolIndex(memoryTypeIndex, strategy, optimalImage);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool& pool = pools[index];
+    Allocation allocation;
+    allocation.pool = index;
+
+    // Large resources would mostly waste a shared block, so they get one of their own
+    if (requirements.size > pool.blockSize / 2) {
+        allocation.block = createBlock(pool, requirements.size, true);
+        allocateFromBlock(pool, pool.blocks[allocation.block], requirements.size, requirements.alignment, allocation);
+        return allocation;
+    }
+
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        Block& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.dedicated) { continue; }
+        if (allocateFromBlock(pool, block, requirements.size, requirements.alignment, allocation)) {
+            allocation.block = i;
+            return allocation;
+        }
+    }
+
+    allocation.block = createBlock(pool, pool.blockSize, false);
+    if (!allocateFromBlock(pool, pool.blocks[allocation.block], requirements.size, requirements.alignment, allocation)) {
+        throw std::runtime_error("failed to sub-allocate from a new memory block!");
+    }
+    return allocation;
+}
+
+void DeviceAllocator::free(Allocation& allocation) {
+    if (!allocation.isValid()) { return; }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool& pool = pools[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+
+    block.allocationCount--;
+    block.usedBytes -= allocation.size;
+    block.paddingBytes -= allocation.padding;
+
+    if (block.dedicated) {
+        releaseBlock(block);
+        allocation = Allocation{};
+        return;
+    }
+
+    if (pool.strategy == AllocationPool::Linear) {
+        // Nothing in a linear block is reused individually; the whole block rewinds once it drains
+        if (block.allocationCount == 0) { block.head = 0; }
+    } else {
+        addFreeRange(block, allocation.offset - allocation.padding, allocation.padding + allocation.size);
+    }
+
+    // Keep one empty block per pool around so alloc/free cycles do not hit vkAllocateMemory every time
+    if (block.allocationCount == 0) {
+        bool hasOtherEmptyBlock = false;
+        for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+            const Block& other = pool.blocks[i];
+            if (i != allocation.block && other.memory != VK_NULL_HANDLE && !other.dedicated && other.allocationCount == 0) {
+                hasOtherEmptyBlock = true;
+            }
+        }
+        if (hasOtherEmptyBlock) { releaseBlock(block); }
+    }
+
+    allocation = Allocation{};
+}
+
+uint32_t DeviceAllocator::createBlock(Pool& pool, VkDeviceSize size, bool dedicated) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+    Block block;
+    block.size = size;
+    block.dedicated = dedicated;
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &block.memory), "failed to allocate device memory block!");
+
+    if (memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped), "failed to map device memory block!");
+    }
+    if (pool.strategy == AllocationPool::General && !dedicated) { addFreeRange(block, 0, size); }
+
+    // Reuse a slot of a released block so existing allocations keep their block index
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+            pool.blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    pool.blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+void DeviceAllocator::releaseBlock(Block& block) {
+    if (block.memory == VK_NULL_HANDLE) { return; }
+    if (block.mapped != nullptr) { vkUnmapMemory(device, block.memory); }
+    vkFreeMemory(device, block.memory, nullptr);
+    block = Block{};
+}
+
+bool DeviceAllocator::allocateFromBlock(Pool& pool, Block& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation) {
+    VkDeviceSize rangeOffset = 0;
+    VkDeviceSize alignedOffset = 0;
+
+    if (pool.strategy == AllocationPool::Linear || block.dedicated) {
+        rangeOffset = block.head;
+        alignedOffset = alignUp(block.head, alignment);
+        if (alignedOffset + size > block.size) { return false; }
+        block.head = alignedOffset + size;
+    } else {
+        // Best fit: the smallest free range that still holds the request after alignment
+        auto it = block.freeBySize.lower_bound(size);
+        for (; it != block.freeBySize.end(); ++it) {
+            alignedOffset = alignUp(it->second, alignment);
+            if (alignedOffset - it->second + size <= it->first) { break; }
+        }
+        if (it == block.freeBySize.end()) { return false; }
+
+        rangeOffset = it->second;
+        VkDeviceSize rangeSize = it->first;
+        removeFreeRange(block, rangeOffset, rangeSize);
+        VkDeviceSize end = alignedOffset + size;
+        if (end < rangeOffset + rangeSize) { addFreeRange(block, end, rangeOffset + rangeSize - end); }
+    }
+
+    block.allocationCount++;
+    block.usedBytes += size;
+    block.paddingBytes += alignedOffset - rangeOffset;
+
+    allocation.memory = block.memory;
+    allocation.offset = alignedOffset;
+    allocation.size = size;
+    allocation.padding = alignedOffset - rangeOffset;
+    allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + alignedOffset : nullptr;
+    return true;
+}
+
+void DeviceAllocator::addFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+    // Merge with the free neighbours on either side
+    auto next = block.freeByOffset.lower_bound(offset);
+    if (next != block.freeByOffset.end() && offset + size == next->first) {
+        VkDeviceSize nextOffset = next->first;
+        VkDeviceSize nextSize = next->second;
+        removeFreeRange(block, nextOffset, nextSize);
+        size += nextSize;
+    }
+    auto previous = block.freeByOffset.lower_bound(offset);
+    if (previous != block.freeByOffset.begin()) {
+        --previous;
+        if (previous->first + previous->second == offset) {
+            VkDeviceSize previousOffset = previous->first;
+            VkDeviceSize previousSize = previous->second;
+            removeFreeRange(block, previousOffset, previousSize);
+            offset = previousOffset;
+            size += previousSize;
+        }
+    }
+
+    block.freeByOffset[offset] = size;
+    block.freeBySize.emplace(size, offset);
+}
+
+void DeviceAllocator::removeFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+    block.freeByOffset.erase(offset);
+    auto range = block.freeBySize.equal_range(size);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == offset) {
+            block.freeBySize.erase(it);
+            return;
+        }
+    }
+}
+
+VkBuffer DeviceAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                       Allocation& allocation, AllocationPool strategy,
+                                       const std::vector<uint32_t>& queueFamilies) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queueFamilies.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+    }
+
+    VkBuffer buffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer), "failed to create buffer!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    allocation = allocate(memRequirements, properties, strategy, false);
+    VK_CHECK(vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset), "failed to bind buffer memory!");
+    return buffer;
+}
+
+void DeviceAllocator::destroyBuffer(VkBuffer& buffer, Allocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) { vkDestroyBuffer(device, buffer, nullptr); }
+    buffer = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+VkImage DeviceAllocator::createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, Allocation& allocation) {
+    VkImage image;
+    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &image), "failed to create image!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    // Linear-tiling images follow the same granularity rules as buffers
+    allocation = allocate(memRequirements, properties, AllocationPool::General, imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL);
+    VK_CHECK(vkBindImageMemory(device, image, allocation.memory, allocation.offset), "failed to bind image memory!");
+    return image;
+}
+
+void DeviceAllocator::destroyImage(VkImage& image, Allocation& allocation) {
+    if (image != VK_NULL_HANDLE) { vkDestroyImage(device, image, nullptr); }
+    image = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+AllocatorStats DeviceAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    AllocatorStats result;
+    for (const auto& pool : pools) {
+        for (const auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) { continue; }
+            result.blockCount++;
+            if (block.dedicated) { result.dedicatedBlockCount++; }
+            result.allocationCount += block.allocationCount;
+            result.reservedBytes += block.size;
+            result.usedBytes += block.usedBytes;
+            result.wastedBytes += pool.strategy == AllocationPool::Linear && !block.dedicated
+                ? block.head - block.usedBytes
+                : block.paddingBytes;
+        }
+    }
+    return result;
+}
+
+void DeviceAllocator::printStats() const {
+    AllocatorStats s = stats();
+    std::cout << "Device memory: " << s.allocationCount << " allocations in " << s.blockCount << " blocks ("
+              << s.dedicatedBlockCount << " dedicated), " << toMiB(s.reservedBytes) << " MiB reserved, "
+              << toMiB(s.usedBytes) << " MiB used, " << toMiB(s.wastedBytes) << " MiB wasted\n";
+}
@@ -0,0 +1,118 @@
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Which strategy a resource is sub-allocated with
+enum class AllocationPool {
+    // Best-fit free list with coalescing, for long-lived resources
+    General,
+    // Bump allocator for short-lived resources (staging, readback); a block rewinds once all of its
+    // allocations have been freed
+    Linear,
+};
+
+// A sub-range of a VkDeviceMemory block. Bind resources at (memory, offset).
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Host pointer to offset when the memory type is host visible (blocks stay persistently mapped)
+    void* mapped = nullptr;
+
+    // Owner bookkeeping, only meaningful to DeviceAllocator
+    uint32_t pool = UINT32_MAX;
+    uint32_t block = 0;
+    VkDeviceSize padding = 0;
+
+    [[nodiscard]] bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct AllocatorStats {
+    uint32_t blockCount = 0;
+    uint32_t dedicatedBlockCount = 0;
+    uint32_t allocationCount = 0;
+    // VkDeviceMemory taken from the driver
+    VkDeviceSize reservedBytes = 0;
+    // Requested by live allocations
+    VkDeviceSize usedBytes = 0;
+    // Neither used nor reusable: alignment padding plus linear space waiting for its block to rewind
+    VkDeviceSize wastedBytes = 0;
+};
+
+// Sub-allocates buffers and images from large VkDeviceMemory blocks instead of one vkAllocateMemory
+// per resource. Blocks are grouped into pools by memory type, strategy and resource kind; buffers and
+// optimal-tiling images never share a block, so bufferImageGranularity can be ignored. Resources larger
+// than half a block get a dedicated block. All methods are thread safe.
+class DeviceAllocator {
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device);
+    // Frees every block; allocations still alive at this point are reported as leaks
+    void cleanup();
+
+    Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                        AllocationPool strategy = AllocationPool::General, bool optimalImage = false);
+    void free(Allocation& allocation);
+
+    // Create a resource and bind it to a fresh sub-allocation. Buffers used by more than one queue family
+    // list those families and are created with VK_SHARING_MODE_CONCURRENT.
+    VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                          Allocation& allocation, AllocationPool strategy = AllocationPool::General,
+                          const std::vector<uint32_t>& queueFamilies = {});
+    void destroyBuffer(VkBuffer& buffer, Allocation& allocation);
+    VkImage createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, Allocation& allocation);
+    void destroyImage(VkImage& image, Allocation& allocation);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+    [[nodiscard]] AllocatorStats stats() const;
+    void printStats() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        bool dedicated = false;
+        uint32_t allocationCount = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize paddingBytes = 0;
+
+        // General pools: free ranges indexed both ways, so best fit and coalescing are O(log n)
+        std::map<VkDeviceSize, VkDeviceSize> freeByOffset;
+        std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;
+
+        // Linear pools: everything below head has been handed out
+        VkDeviceSize head = 0;
+    };
+
+    struct Pool {
+        uint32_t memoryTypeIndex = 0;
+        AllocationPool strategy = AllocationPool::General;
+        VkDeviceSize blockSize = 0;
+        std::vector<Block> blocks;
+    };
+
+    // Preferred block size; small heaps (e.g. 256 MiB BAR memory) get at most an eighth of the heap
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<Pool> pools;
+    mutable std::mutex mutex;
+
+    uint32_t poolIndex(uint32_t memoryTypeIndex, AllocationPool strategy, bool optimalImage) const;
+    uint32_t createBlock(Pool& pool, VkDeviceSize size, bool dedicated);
+    void releaseBlock(Block& block);
+    bool allocateFromBlock(Pool& pool, Block& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+    void addFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+    void removeFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+};
+
+#endif // MEMORY_ALLOCATOR_H
@@ -1,20 +1,11 @@
 #include "Mesh.h"
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
-
-// Helper function to find memory type
-uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
+#include <stdexcept>
 
 VkVertexInputBindingDescription Vertex::getBindingDescription() {
     VkVertexInputBindingDescription bindingDescription{};
@@ -49,283 +40,311 @@ std::vector<VkVertexInputAttributeDescription> Vertex::getAttributeDescriptions(
     return attributeDescriptions;
 }
 
-void Mesh::createVertexBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
-                             VkQueue graphicsQueue, VkCommandPool commandPool) {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    
-    // Create staging buffer
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create staging buffer!");
-    }
+std::vector<VkVertexInputBindingDescription> Vertex::getSplitBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+    // Position stream
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(glm::vec3);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // Normal + texture coordinate stream
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(VertexAttributes);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate staging buffer memory!");
-    }
+    return bindingDescriptions;
+}
 
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
+std::vector<VkVertexInputAttributeDescription> Vertex::getSplitAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
 
-    // Copy data to staging buffer
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    // Position attribute
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = 0;
 
-    // Create vertex buffer
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create vertex buffer!");
-    }
+    // Normal attribute
+    attributeDescriptions[1].binding = 1;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(VertexAttributes, normal);
 
-    vkGetBufferMemoryRequirements(device, vertexBuffer, &memRequirements);
+    // Texture coordinate attribute
+    attributeDescriptions[2].binding = 1;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(VertexAttributes, texCoord);
 
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
+    return attributeDescriptions;
+}
 
-    vkBindBufferMemory(device, vertexBuffer, vertexBufferMemory, 0);
+VkVertexInputBindingDescription PackedVertex::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(PackedVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    // Copy from staging buffer to vertex buffer
-    VkCommandBufferAllocateInfo allocInfoCmd{};
-    allocInfoCmd.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfoCmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfoCmd.commandPool = commandPool;
-    allocInfoCmd.commandBufferCount = 1;
+    return bindingDescription;
+}
 
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfoCmd, &commandBuffer);
+std::vector<VkVertexInputAttributeDescription> PackedVertex::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
 
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // Position attribute (normalized to [0, 1] within the mesh bounds)
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(PackedVertex, position);
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    // Octahedral normal attribute (decoded in the vertex shader)
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(PackedVertex, normal);
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = bufferSize;
-    vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, 1, &copyRegion);
+    // Texture coordinate attribute
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
 
-    vkEndCommandBuffer(commandBuffer);
+    return attributeDescriptions;
+}
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+// Octahedral mapping: project onto the octahedron |x|+|y|+|z| = 1 and fold the lower half over the diagonals
+static glm::vec2 encodeOctahedral(glm::vec3 n) {
+    n = n / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return p;
+}
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+// Same steps as octahedralDecode() in shader.vert
+static glm::vec3 decodeOctahedral(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+static int16_t packSnorm16(float v) {
+    return static_cast<int16_t>(std::round(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+// VK_FORMAT_*_SNORM conversion rule
+static float unpackSnorm16(int16_t v) {
+    return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+// atan2 stays accurate for tiny angles, where acos(dot) is limited by float precision near 1
+static float angleBetween(glm::vec3 a, glm::vec3 b) {
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
 }
 
-void Mesh::createIndexBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
-                            VkQueue graphicsQueue, VkCommandPool commandPool) {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create staging buffer!");
+void Mesh::computeBounds() {
+    if (vertices.empty()) { return; }
+
+    glm::vec3 boundsMax = vertices[0].position;
+    boundsMin = vertices[0].position;
+    for (const auto& vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
     }
+    boundsExtent = boundsMax - boundsMin;
+}
+
+void Mesh::quantize() {
+    if (vertices.empty()) { return; }
+    computeBounds();
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+    packedVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& packed = packedVertices[i];
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        for (int axis = 0; axis < 3; axis++) {
+            // A flat axis (e.g. a plane) has no extent; every vertex sits at the minimum
+            float normalized = boundsExtent[axis] > 0.0f ? (vertex.position[axis] - boundsMin[axis]) / boundsExtent[axis] : 0.0f;
+            packed.position[axis] = static_cast<uint16_t>(std::round(std::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+        }
+        packed.position[3] = 0;
+
+        // Rounding each component independently is not always closest on the sphere, so try the four
+        // neighbouring snorm16 pairs and keep the one that decodes nearest to the source normal
+        glm::vec3 normal = glm::normalize(vertex.normal);
+        glm::vec2 octahedral = encodeOctahedral(normal);
+        float bestAngle = 4.0f;
+        for (int corner = 0; corner < 4; corner++) {
+            float x = (corner & 1 ? std::ceil(octahedral.x * 32767.0f) : std::floor(octahedral.x * 32767.0f)) / 32767.0f;
+            float y = (corner & 2 ? std::ceil(octahedral.y * 32767.0f) : std::floor(octahedral.y * 32767.0f)) / 32767.0f;
+            int16_t candidate[2] = {packSnorm16(x), packSnorm16(y)};
+            float angle = angleBetween(normal, decodeOctahedral(glm::vec2(unpackSnorm16(candidate[0]), unpackSnorm16(candidate[1]))));
+            if (angle < bestAngle) {
+                bestAngle = angle;
+                packed.normal[0] = candidate[0];
+                packed.normal[1] = candidate[1];
+            }
+        }
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate staging buffer memory!");
+        packed.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+        packed.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
     }
+    vertexFormat = VertexFormat::Packed;
+}
+
+QuantizationError Mesh::measureQuantizationError() const {
+    QuantizationError error;
+    for (size_t i = 0; i < packedVertices.size() && i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        const PackedVertex& packed = packedVertices[i];
 
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
+        glm::vec3 position;
+        for (int axis = 0; axis < 3; axis++) { position[axis] = boundsMin[axis] + (packed.position[axis] / 65535.0f) * boundsExtent[axis]; }
+        error.position = std::max(error.position, glm::length(position - vertex.position));
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+        glm::vec3 normal = decodeOctahedral(glm::vec2(unpackSnorm16(packed.normal[0]), unpackSnorm16(packed.normal[1])));
+        error.normalDegrees = std::max(error.normalDegrees, glm::degrees(angleBetween(normal, glm::normalize(vertex.normal))));
 
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &indexBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create index buffer!");
+        glm::vec2 texCoord(glm::unpackHalf1x16(packed.texCoord[0]), glm::unpackHalf1x16(packed.texCoord[1]));
+        error.texCoord = std::max(error.texCoord, glm::length(texCoord - vertex.texCoord));
     }
+    return error;
+}
 
-    vkGetBufferMemoryRequirements(device, indexBuffer, &memRequirements);
+void Mesh::splitStreams() {
+    if (vertexFormat != VertexFormat::Float) { throw std::runtime_error("split vertex streams require the float vertex format!"); }
 
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &indexBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate index buffer memory!");
+    positions.resize(vertices.size());
+    attributes.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+        attributes[i].normal = vertices[i].normal;
+        attributes[i].texCoord = vertices[i].texCoord;
     }
+    vertexLayout = VertexLayout::Split;
+}
 
-    vkBindBufferMemory(device, indexBuffer, indexBufferMemory, 0);
+std::vector<VkVertexInputBindingDescription> Mesh::getBindingDescriptions() const {
+    if (vertexFormat == VertexFormat::Packed) { return {PackedVertex::getBindingDescription()}; }
+    if (vertexLayout == VertexLayout::Split) { return Vertex::getSplitBindingDescriptions(); }
+    return {Vertex::getBindingDescription()};
+}
 
-    VkCommandBufferAllocateInfo allocInfoCmd{};
-    allocInfoCmd.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfoCmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfoCmd.commandPool = commandPool;
-    allocInfoCmd.commandBufferCount = 1;
+std::vector<VkVertexInputAttributeDescription> Mesh::getAttributeDescriptions() const {
+    if (vertexFormat == VertexFormat::Packed) { return PackedVertex::getAttributeDescriptions(); }
+    if (vertexLayout == VertexLayout::Split) { return Vertex::getSplitAttributeDescriptions(); }
+    return Vertex::getAttributeDescriptions();
+}
 
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfoCmd, &commandBuffer);
+std::vector<VkVertexInputBindingDescription> Mesh::getPositionBindingDescriptions() const {
+    // Binding 0 holds the positions in every format and layout (alone in the split layout)
+    std::vector<VkVertexInputBindingDescription> bindings = getBindingDescriptions();
+    bindings.resize(1);
+    return bindings;
+}
 
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+std::vector<VkVertexInputAttributeDescription> Mesh::getPositionAttributeDescriptions() const {
+    // Location 0 is always the position and comes first
+    std::vector<VkVertexInputAttributeDescription> attributes = getAttributeDescriptions();
+    attributes.resize(1);
+    return attributes;
+}
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+void Mesh::bindVertexBuffers(VkCommandBuffer commandBuffer) const {
+    VkBuffer buffers[] = {vertexBuffer, vertexBuffer};
+    VkDeviceSize offsets[] = {0, attributeStreamOffset};
+    uint32_t bindingCount = vertexLayout == VertexLayout::Split ? 2 : 1;
+    vkCmdBindVertexBuffers(commandBuffer, 0, bindingCount, buffers, offsets);
+}
+
+MeshLod Mesh::selectLod(float pixelsPerUnit, float maxPixelError) const {
+    if (lods.empty()) {
+        // Cached meshes carry no CPU indices, only the count of the uploaded ones
+        uint32_t count = indices.empty() ? indexCount : static_cast<uint32_t>(indices.size());
+        return {0, count, 0.0f, 0, static_cast<uint32_t>(meshlets.size())};
+    }
+
+    // Errors grow with each level, so the last one that passes is the coarsest acceptable
+    MeshLod selected = lods[0];
+    for (const MeshLod& lod : lods) {
+        if (lod.error * pixelsPerUnit > maxPixelError) { break; }
+        selected = lod;
+    }
+    return selected;
+}
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = bufferSize;
-    vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &copyRegion);
+void Mesh::bindIndexBuffer(VkCommandBuffer commandBuffer) const {
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+}
 
-    vkEndCommandBuffer(commandBuffer);
+MeshBoundsPushConstants Mesh::getBoundsPushConstants() const {
+    MeshBoundsPushConstants bounds{};
+    bounds.boundsMin = glm::vec4(boundsMin, 0.0f);
+    bounds.boundsExtent = glm::vec4(boundsExtent, 0.0f);
+    return bounds;
+}
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+std::vector<BufferRegion> Mesh::getVertexBufferRegions() {
+    if (vertexLayout == VertexLayout::Split) {
+        // Both streams share one buffer; the attribute stream starts at the next 16-byte boundary
+        VkDeviceSize positionBytes = sizeof(glm::vec3) * positions.size();
+        attributeStreamOffset = (positionBytes + 15) / 16 * 16;
+        return {{0, positions.data(), positionBytes},
+                {attributeStreamOffset, attributes.data(), sizeof(VertexAttributes) * attributes.size()}};
+    }
+    if (vertexFormat == VertexFormat::Packed) { return {{0, packedVertices.data(), sizeof(PackedVertex) * packedVertices.size()}}; }
+    return {{0, vertices.data(), sizeof(Vertex) * vertices.size()}};
+}
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+BufferRegion Mesh::getIndexBufferRegion(std::vector<uint16_t>& narrowed) {
+    // Every index fits in 16 bits when there are at most 65536 vertices (no primitive restart is used)
+    if (vertices.size() <= 65536) {
+        narrowed.assign(indices.begin(), indices.end());
+        indexType = VK_INDEX_TYPE_UINT16;
+        return {0, narrowed.data(), sizeof(uint16_t) * narrowed.size()};
+    }
+    indexType = VK_INDEX_TYPE_UINT32;
+    return {0, indices.data(), sizeof(uint32_t) * indices.size()};
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+UploadTicket Mesh::createVertexBuffer(DeviceAllocator& allocator, UploadManager& uploader) {
+    std::vector<BufferRegion> regions = cacheFile ? std::vector<BufferRegion>{cachedVertexData} : getVertexBufferRegions();
+    VkDeviceSize bufferSize = regions.back().offset + regions.back().size;
+    vertexBuffer = allocator.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexAllocation, AllocationPool::General, uploader.getQueueFamilies());
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    UploadTicket ticket = 0;
+    for (const BufferRegion& region : regions) { ticket = uploader.uploadBuffer(vertexBuffer, region.offset, region.data, region.size); }
+    return ticket;
 }
 
-void Mesh::cleanup(VkDevice device) {
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
+UploadTicket Mesh::createIndexBuffer(DeviceAllocator& allocator, UploadManager& uploader) {
+    std::vector<uint16_t> narrowed;
+    BufferRegion region = cachedIndexData;
+    if (!cacheFile) {
+        indexCount = static_cast<uint32_t>(indices.size());
+        region = getIndexBufferRegion(narrowed);
+    }
 
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    // uploadBuffer() copies into staging right away, so the narrowed copy may go out of scope
+    indexBuffer = allocator.createBuffer(region.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexAllocation, AllocationPool::General, uploader.getQueueFamilies());
+    return uploader.uploadBuffer(indexBuffer, 0, region.data, region.size);
 }
 
-Mesh MeshGenerator::generateCube(float width, float height, float depth) {
-    Mesh mesh;
-    
-    // Half dimensions
-    float w = width / 2.0f;
-    float h = height / 2.0f;
-    float d = depth / 2.0f;
-
-    // Create vertices for a cube with proper normals and texture coordinates
-    mesh.vertices = {
-        // Front face
-        {{-w, -h,  d}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f}},
-        {{ w, -h,  d}, { 0.0f,  0.0f,  1.0f}, {1.0f, 0.0f}},
-        {{ w,  h,  d}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f}},
-        {{-w,  h,  d}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f}},
-
-        // Back face
-        {{-w, -h, -d}, { 0.0f,  0.0f, -1.0f}, {0.0f, 0.0f}},
-        {{-w,  h, -d}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.0f}},
-        {{ w,  h, -d}, { 0.0f,  0.0f, -1.0f}, {1.0f, 1.0f}},
-        {{ w, -h, -d}, { 0.0f,  0.0f, -1.0f}, {0.0f, 1.0f}},
-
-        // Top face
-        {{-w,  h, -d}, { 0.0f,  1.0f,  0.0f}, {0.0f, 0.0f}},
-        {{-w,  h,  d}, { 0.0f,  1.0f,  0.0f}, {1.0f, 0.0f}},
-        {{ w,  h,  d}, { 0.0f,  1.0f,  0.0f}, {1.0f, 1.0f}},
-        {{ w,  h, -d}, { 0.0f,  1.0f,  0.0f}, {0.0f, 1.0f}},
-
-        // Bottom face
-        {{-w, -h, -d}, { 0.0f, -1.0f,  0.0f}, {0.0f, 0.0f}},
-        {{ w, -h, -d}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.0f}},
-        {{ w, -h,  d}, { 0.0f, -1.0f,  0.0f}, {1.0f, 1.0f}},
-        {{-w, -h,  d}, { 0.0f, -1.0f,  0.0f}, {0.0f, 1.0f}},
-
-        // Right face
-        {{ w, -h, -d}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
-        {{ w,  h, -d}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
-        {{ w,  h,  d}, { 1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
-        {{ w, -h,  d}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
-
-        // Left face
-        {{-w, -h, -d}, {-1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
-        {{-w, -h,  d}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
-        {{-w,  h,  d}, {-1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
-        {{-w,  h, -d}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}}
-    };
-
-    // Create indices for the cube faces
-    mesh.indices = {
-        // Front face
-        0, 1, 2, 2, 3, 0,
-        // Back face
-        4, 5, 6, 6, 7, 4,
-        // Top face
-        8, 9, 10, 10, 11, 8,
-        // Bottom face
-        12, 13, 14, 14, 15, 12,
-        // Right face
-        16, 17, 18, 18, 19, 16,
-        // Left face
-        20, 21, 22, 22, 23, 20
-    };
-
-    return mesh;
+void Mesh::releaseCachedData() {
+    cacheFile.reset();
+    cachedVertexData = BufferRegion{};
+    cachedIndexData = BufferRegion{};
 }
 
-Mesh MeshGenerator::generatePlane(float width, float height) {
-    Mesh mesh;
-    
-    // Half dimensions
-    float w = width / 2.0f;
-    float h = height / 2.0f;
-
-    // Create vertices for a plane
-    mesh.vertices = {
-        {{-w, 0.0f, -h}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-        {{ w, 0.0f, -h}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-        {{ w, 0.0f,  h}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
-        {{-w, 0.0f,  h}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}
-    };
-
-    // Create indices for the plane
-    mesh.indices = {
-        0, 1, 2, 2, 3, 0
-    };
-
-    return mesh;
-}
\ No newline at end of file
+void Mesh::cleanup(DeviceAllocator& allocator) {
+    allocator.destroyBuffer(indexBuffer, indexAllocation);
+    allocator.destroyBuffer(vertexBuffer, vertexAllocation);
+}
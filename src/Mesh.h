@@ -1,11 +1,17 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <glm/glm.hpp>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "MemoryAllocator.h"
+#include "Meshlet.h"
+#include "UploadManager.h"
+
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
@@ -13,29 +19,152 @@ struct Vertex {
 
     static VkVertexInputBindingDescription getBindingDescription();
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    // Split layout: positions on binding 0, VertexAttributes on binding 1, same shader locations
+    static std::vector<VkVertexInputBindingDescription> getSplitBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getSplitAttributeDescriptions();
+};
+
+// Everything but the position, for the second stream of the split layout
+struct VertexAttributes {
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// Compact 16-byte vertex: positions as unorm16 relative to the mesh bounds (w unused, kept for the
+// mandatory R16G16B16A16 format), octahedral-encoded normals as 2x snorm16, UVs as half floats.
+// Positions are expanded in the vertex shader with MeshBoundsPushConstants.
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+};
+
+// Dequantization parameters for PackedVertex positions: position = boundsMin + unorm * boundsExtent
+struct MeshBoundsPushConstants {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsExtent;
+};
+
+// How vertex data is laid out in the vertex buffer
+enum class VertexLayout {
+    // One interleaved stream on binding 0
+    Interleaved,
+    // Positions (12 bytes) and attributes in separate streams, so position-only passes fetch just positions
+    Split,
+};
+
+enum class VertexFormat {
+    // Vertex, 32 bytes
+    Float,
+    // PackedVertex, 16 bytes
+    Packed,
 };
 
+// Largest differences between the source vertices and their decoded packed versions
+struct QuantizationError {
+    float position = 0.0f;
+    // Angle between source and decoded normal, in degrees
+    float normalDegrees = 0.0f;
+    float texCoord = 0.0f;
+};
+
+// One level of detail: a range of the shared index buffer over the shared vertex buffer
+struct MeshLod {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // Largest object-space distance between this level and the source surface
+    float error = 0.0f;
+    // This level's clusters in Mesh::meshlets, filled by MeshletBuilder::buildForMesh()
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+};
+
+// A piece of a GPU buffer's contents: size bytes at data, destined for the given buffer offset
+struct BufferRegion {
+    VkDeviceSize offset = 0;
+    const void* data = nullptr;
+    VkDeviceSize size = 0;
+};
+
+class MappedFile;
+
 struct Mesh {
     std::vector<Vertex> vertices;
+    // Always 32-bit on the CPU; createIndexBuffer() narrows them to 16 bits when the vertex count allows
     std::vector<uint32_t> indices;
 
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    // Axis-aligned bounds of vertices, set by computeBounds() (and quantize())
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsExtent = glm::vec3(0.0f);
 
-    void createVertexBuffer(VkPhysicalDevice physicalDevice, VkDevice device, 
-                          VkQueue graphicsQueue, VkCommandPool commandPool);
-    void createIndexBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
-                         VkQueue graphicsQueue, VkCommandPool commandPool);
-    void cleanup(VkDevice device);
-};
+    // Filled by quantize(); the packed layout is uploaded instead of vertices when present
+    VertexFormat vertexFormat = VertexFormat::Float;
+    std::vector<PackedVertex> packedVertices;
+
+    // Filled by splitStreams(); positions and attributes are uploaded as two streams of one buffer
+    VertexLayout vertexLayout = VertexLayout::Interleaved;
+    std::vector<glm::vec3> positions;
+    std::vector<VertexAttributes> attributes;
+    VkDeviceSize attributeStreamOffset = 0;
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    Allocation vertexAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    Allocation indexAllocation;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    uint32_t indexCount = 0;
+
+    // Levels of detail from finest to coarsest, filled by MeshSimplifier::buildLodChain(); empty means the
+    // whole index buffer is the only level
+    std::vector<MeshLod> lods;
+    // Clusters of every level, filled by MeshletBuilder::buildForMesh()
+    std::vector<Meshlet> meshlets;
+
+    // Set by MeshCache::load(): upload-ready buffer contents inside the mapped cache file. A cached mesh
+    // has no CPU-side vertices or indices; the buffers are uploaded from these bytes instead.
+    std::shared_ptr<const MappedFile> cacheFile;
+    BufferRegion cachedVertexData;
+    BufferRegion cachedIndexData;
+
+    // Queue the data for upload; the buffers may be used once the returned ticket has completed
+    UploadTicket createVertexBuffer(DeviceAllocator& allocator, UploadManager& uploader);
+    UploadTicket createIndexBuffer(DeviceAllocator& allocator, UploadManager& uploader);
+    void cleanup(DeviceAllocator& allocator);
+    // Unmaps the cache file once the uploads have copied its bytes to staging
+    void releaseCachedData();
+
+    // Buffer contents exactly as createVertexBuffer() and createIndexBuffer() upload them, for the current
+    // format and layout. The vertex regions also fix attributeStreamOffset; the index region fixes
+    // indexType and may point into narrowed, which must outlive its use.
+    std::vector<BufferRegion> getVertexBufferRegions();
+    BufferRegion getIndexBufferRegion(std::vector<uint16_t>& narrowed);
+
+    void computeBounds();
+    // Encodes vertices into packedVertices and switches the mesh to VertexFormat::Packed
+    void quantize();
+    // Copies vertices into the positions/attributes streams and switches to VertexLayout::Split.
+    // Only valid for the float format.
+    void splitStreams();
+
+    // Vertex input state and binding commands matching vertexFormat and vertexLayout
+    [[nodiscard]] std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+    [[nodiscard]] std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+    // Vertex input of depth-only passes: binding 0 with the position attribute alone. Buffers bound with
+    // bindVertexBuffers() serve both.
+    [[nodiscard]] std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions() const;
+    [[nodiscard]] std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions() const;
+    void bindVertexBuffers(VkCommandBuffer commandBuffer) const;
+    void bindIndexBuffer(VkCommandBuffer commandBuffer) const;
+    // Decodes packedVertices on the CPU exactly like the vertex shader does and compares with vertices
+    [[nodiscard]] QuantizationError measureQuantizationError() const;
+    [[nodiscard]] MeshBoundsPushConstants getBoundsPushConstants() const;
 
-class MeshGenerator {
-public:
-    static Mesh generateCube(float width, float height, float depth);
-    static Mesh generatePlane(float width, float height);
-    // Other mesh generation functions can be added here
+    // Coarsest level whose error, projected at pixelsPerUnit (screen pixels per object-space unit at the
+    // mesh's distance), stays within maxPixelError
+    [[nodiscard]] MeshLod selectLod(float pixelsPerUnit, float maxPixelError) const;
 };
 
 #endif // MESH_H
\ No newline at end of file
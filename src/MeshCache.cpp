@@ -0,0 +1,188 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+struct BlobRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t lodRecordSize;
+    uint32_t meshletRecordSize;
+    uint32_t options;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    float weldEpsilon;
+
+    uint32_t vertexFormat;
+    uint32_t vertexLayout;
+    uint32_t indexType;
+    uint32_t indexCount;
+    uint64_t attributeStreamOffset;
+    float boundsMin[3];
+    float boundsExtent[3];
+    uint32_t lodCount;
+    uint32_t meshletCount;
+
+    BlobRange vertices;
+    BlobRange indices;
+    BlobRange lods;
+    BlobRange meshlets;
+};
+
+static_assert(std::is_trivially_copyable<MeshCacheHeader>::value, "cache header must be written as raw bytes");
+static_assert(std::is_trivially_copyable<MeshLod>::value, "LOD records are written as raw bytes");
+static_assert(std::is_trivially_copyable<Meshlet>::value, "meshlet records are written as raw bytes");
+
+uint64_t alignBlob(uint64_t offset) {
+    return (offset + MeshCache::BLOB_ALIGNMENT - 1) / MeshCache::BLOB_ALIGNMENT * MeshCache::BLOB_ALIGNMENT;
+}
+
+bool inFile(const BlobRange& range, size_t fileSize) {
+    return range.offset % MeshCache::BLOB_ALIGNMENT == 0 && range.offset <= fileSize && range.size <= fileSize - range.offset;
+}
+
+} // namespace
+
+MeshCacheKey MeshCache::makeKey(const std::string& sourcePath, uint32_t options, float weldEpsilon) {
+    MeshCacheKey key;
+    key.sourceSize = static_cast<uint64_t>(std::filesystem::file_size(sourcePath));
+    key.sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath).time_since_epoch().count());
+    key.options = options;
+    key.weldEpsilon = weldEpsilon;
+    return key;
+}
+
+bool MeshCache::load(const std::string& path, const MeshCacheKey& key, Mesh& mesh) {
+    TRACE_SCOPE("MeshCache::load");
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) { return false; }
+
+    auto file = std::make_shared<MappedFile>(path);
+    if (file->size() < sizeof(MeshCacheHeader)) { return false; }
+    MeshCacheHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (header.magic != MAGIC || header.version != VERSION || header.headerSize != sizeof(MeshCacheHeader)
+        || header.lodRecordSize != sizeof(MeshLod) || header.meshletRecordSize != sizeof(Meshlet)) {
+        return false;
+    }
+    if (header.sourceSize != key.sourceSize || header.sourceTime != key.sourceTime || header.options != key.options
+        || header.weldEpsilon != key.weldEpsilon) { return false; }
+    if (!inFile(header.vertices, file->size()) || !inFile(header.indices, file->size()) || !inFile(header.lods, file->size())
+        || !inFile(header.meshlets, file->size()) || header.lods.size != uint64_t(header.lodCount) * sizeof(MeshLod)
+        || header.meshlets.size != uint64_t(header.meshletCount) * sizeof(Meshlet) || header.vertices.size == 0) {
+        return false;
+    }
+    if (header.indexType != VK_INDEX_TYPE_UINT16 && header.indexType != VK_INDEX_TYPE_UINT32) { return false; }
+    uint64_t indexSize = header.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+    if (header.indices.size != uint64_t(header.indexCount) * indexSize) { return false; }
+    // The enums and ranges below end up in vertex bindings and draw calls, so a corrupt file must not get past them
+    if (header.vertexFormat > static_cast<uint32_t>(VertexFormat::Packed)
+        || header.vertexLayout > static_cast<uint32_t>(VertexLayout::Split)
+        || header.attributeStreamOffset >= header.vertices.size) {
+        return false;
+    }
+
+    const char* base = file->data();
+    Mesh cached;
+    cached.vertexFormat = static_cast<VertexFormat>(header.vertexFormat);
+    cached.vertexLayout = static_cast<VertexLayout>(header.vertexLayout);
+    cached.indexType = header.indexType == VK_INDEX_TYPE_UINT16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    cached.indexCount = header.indexCount;
+    cached.attributeStreamOffset = header.attributeStreamOffset;
+    cached.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    cached.boundsExtent = glm::vec3(header.boundsExtent[0], header.boundsExtent[1], header.boundsExtent[2]);
+    // The tables are a few records per level or cluster, small enough to copy
+    cached.lods.resize(header.lodCount);
+    if (header.lodCount > 0) { std::memcpy(cached.lods.data(), base + header.lods.offset, header.lods.size); }
+    cached.meshlets.resize(header.meshletCount);
+    if (header.meshletCount > 0) { std::memcpy(cached.meshlets.data(), base + header.meshlets.offset, header.meshlets.size); }
+    for (const MeshLod& lod : cached.lods) {
+        if (uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount
+            || uint64_t(lod.firstMeshlet) + lod.meshletCount > header.meshletCount) {
+            return false;
+        }
+    }
+    for (const Meshlet& meshlet : cached.meshlets) {
+        if (uint64_t(meshlet.firstIndex) + uint64_t(meshlet.triangleCount) * 3 > header.indexCount) { return false; }
+    }
+
+    cached.cachedVertexData = {0, base + header.vertices.offset, header.vertices.size};
+    cached.cachedIndexData = {0, base + header.indices.offset, header.indices.size};
+    cached.cacheFile = std::move(file);
+    mesh = std::move(cached);
+    return true;
+}
+
+void MeshCache::save(const std::string& path, const MeshCacheKey& key, Mesh& mesh) {
+    TRACE_SCOPE("MeshCache::save");
+    std::vector<BufferRegion> vertexRegions = mesh.getVertexBufferRegions();
+    std::vector<uint16_t> narrowed;
+    BufferRegion indexRegion = mesh.getIndexBufferRegion(narrowed);
+
+    MeshCacheHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.headerSize = sizeof(MeshCacheHeader);
+    header.lodRecordSize = sizeof(MeshLod);
+    header.meshletRecordSize = sizeof(Meshlet);
+    header.options = key.options;
+    header.weldEpsilon = key.weldEpsilon;
+    header.sourceSize = key.sourceSize;
+    header.sourceTime = key.sourceTime;
+    header.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+    header.vertexLayout = static_cast<uint32_t>(mesh.vertexLayout);
+    header.indexType = static_cast<uint32_t>(mesh.indexType);
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    header.attributeStreamOffset = mesh.attributeStreamOffset;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsExtent[i] = mesh.boundsExtent[i];
+    }
+    header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+    header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+
+    header.vertices = {alignBlob(sizeof(MeshCacheHeader)), vertexRegions.back().offset + vertexRegions.back().size};
+    header.indices = {alignBlob(header.vertices.offset + header.vertices.size), indexRegion.size};
+    header.lods = {alignBlob(header.indices.offset + header.indices.size), sizeof(MeshLod) * mesh.lods.size()};
+    header.meshlets = {alignBlob(header.lods.offset + header.lods.size), sizeof(Meshlet) * mesh.meshlets.size()};
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out) { throw std::runtime_error("failed to create mesh cache: " + temporaryPath); }
+
+        uint64_t position = 0;
+        auto writeAt = [&](uint64_t offset, const void* data, uint64_t size) {
+            static const char zeros[BLOB_ALIGNMENT] = {};
+            while (position < offset) {
+                uint64_t padding = std::min<uint64_t>(offset - position, BLOB_ALIGNMENT);
+                out.write(zeros, static_cast<std::streamsize>(padding));
+                position += padding;
+            }
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            position += size;
+        };
+        writeAt(0, &header, sizeof(header));
+        for (const BufferRegion& region : vertexRegions) { writeAt(header.vertices.offset + region.offset, region.data, region.size); }
+        writeAt(header.indices.offset, indexRegion.data, indexRegion.size);
+        writeAt(header.lods.offset, mesh.lods.data(), header.lods.size);
+        writeAt(header.meshlets.offset, mesh.meshlets.data(), header.meshlets.size);
+
+        if (!out) { throw std::runtime_error("failed to write mesh cache: " + temporaryPath); }
+    }
+    std::filesystem::rename(temporaryPath, path);
+}
@@ -0,0 +1,46 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "Mesh.h"
+
+// What a cache file was built from: the state of its source asset and the processing applied to it.
+// A cache whose key differs from the current one is stale and gets rebuilt.
+struct MeshCacheKey {
+    uint64_t sourceSize = 0;
+    // Source modification time in file clock ticks
+    int64_t sourceTime = 0;
+    // Caller-defined bits for every option that changes the stored data (optimization, LODs, formats...)
+    uint32_t options = 0;
+    // Position tolerance the mesh was welded with (0 when it was not welded); compared exactly
+    float weldEpsilon = 0.0f;
+};
+
+// Versioned binary container for fully processed meshes. The vertex and index blobs hold the exact
+// upload-ready bytes (any vertex format or layout, 16- or 32-bit indices), so loading maps the file,
+// validates the header and points the mesh at the blobs: no parsing or per-vertex work, and the upload
+// copies straight from the mapping into staging. Bounds, the LOD table and meshlets are stored too.
+//
+// Layout, little endian: MeshCacheHeader at offset 0, then the vertex blob, index blob, LOD table and
+// meshlet table, each starting on a BLOB_ALIGNMENT boundary. Record sizes are checked on load, so a
+// cache written by a build with different struct layouts is rejected instead of misread.
+class MeshCache {
+public:
+    static constexpr uint32_t MAGIC = 0x434D4B56;  // "VKMC"
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint64_t BLOB_ALIGNMENT = 64;
+
+    // Throws if the source cannot be examined
+    static MeshCacheKey makeKey(const std::string& sourcePath, uint32_t options, float weldEpsilon);
+
+    // Fills mesh from the cache at path (see Mesh::cacheFile). Returns false and leaves mesh untouched
+    // when the file is missing, malformed, from another version or built for another key.
+    static bool load(const std::string& path, const MeshCacheKey& key, Mesh& mesh);
+    // Writes mesh in its current format and layout. The file is written under a temporary name and then
+    // renamed, so readers never see a partial cache.
+    static void save(const std::string& path, const MeshCacheKey& key, Mesh& mesh);
+};
+
+#endif // MESH_CACHE_H
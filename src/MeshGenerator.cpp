@@ -0,0 +1,405 @@
+#include "MeshGenerator.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+// Below this many vertices per thread, spawning the thread costs more than it saves
+constexpr uint32_t MIN_VERTICES_PER_THREAD = 16 * 1024;
+
+MeshSize checkedSize(uint64_t vertexCount, uint64_t indexCount) {
+    if (vertexCount > std::numeric_limits<uint32_t>::max() || indexCount > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("generated mesh exceeds 32-bit vertex or index counts!");
+    }
+    return {static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(indexCount)};
+}
+
+uint32_t minRowsPerThread(uint32_t verticesPerRow) {
+    return std::max(1u, MIN_VERTICES_PER_THREAD / std::max(1u, verticesPerRow));
+}
+
+// (cos, sin) of count + 1 evenly spaced angles over a full turn. The last entry repeats the first
+// exactly, so seam vertices get bit-identical positions.
+std::vector<glm::vec2> angleTable(uint32_t count) {
+    std::vector<glm::vec2> table(count + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        float angle = 2.0f * PI * static_cast<float>(i) / static_cast<float>(count);
+        table[i] = glm::vec2(std::cos(angle), std::sin(angle));
+    }
+    table[count] = table[0];
+    return table;
+}
+
+// Two triangles per quad of a row-major vertex grid, wound (a, b, c), (b, d, c) where b is the next
+// column and c the next row
+void writeQuadRows(uint32_t* indices, uint32_t rowBegin, uint32_t rowEnd, uint32_t columns, uint32_t baseVertex) {
+    uint32_t* out = indices + static_cast<size_t>(rowBegin) * (columns - 1) * 6;
+    for (uint32_t row = rowBegin; row < rowEnd; row++) {
+        uint32_t rowStart = baseVertex + row * columns;
+        for (uint32_t column = 0; column + 1 < columns; column++) {
+            uint32_t a = rowStart + column;
+            uint32_t b = a + 1;
+            uint32_t c = a + columns;
+            uint32_t d = c + 1;
+            out[0] = a; out[1] = b; out[2] = c;
+            out[3] = b; out[4] = d; out[5] = c;
+            out += 6;
+        }
+    }
+}
+
+// Runs writeRow(row) for every vertex row in parallel, then the matching quad rows of the indices
+template <typename RowWriter>
+void writeGrid(uint32_t rows, uint32_t columns, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount, RowWriter writeRow) {
+    parallelFor(rows, minRowsPerThread(columns), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; row++) { writeRow(row); }
+        writeQuadRows(indices, begin, std::min(end, rows - 1), columns, baseVertex);
+    }, threadCount);
+}
+
+// Unit icosahedron, faces counter-clockwise from outside
+const float GOLDEN = 1.61803398875f;
+const glm::vec3 ICOSAHEDRON_CORNERS[12] = {
+    {-1, GOLDEN, 0}, {1, GOLDEN, 0}, {-1, -GOLDEN, 0}, {1, -GOLDEN, 0},
+    {0, -1, GOLDEN}, {0, 1, GOLDEN}, {0, -1, -GOLDEN}, {0, 1, -GOLDEN},
+    {GOLDEN, 0, -1}, {GOLDEN, 0, 1}, {-GOLDEN, 0, -1}, {-GOLDEN, 0, 1},
+};
+const uint32_t ICOSAHEDRON_FACES[20][3] = {
+    {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+    {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+    {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+    {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1},
+};
+
+// Longitude of a unit direction in [0, 1), matching the UV sphere's u
+float sphereU(const glm::vec3& direction) {
+    float u = std::atan2(direction.z, direction.x) / (2.0f * PI);
+    return u < 0.0f ? u + 1.0f : u;
+}
+
+} // namespace
+
+Mesh MeshGenerator::generateCube(float width, float height, float depth) {
+    Mesh mesh;
+    
+    // Half dimensions
+    float w = width / 2.0f;
+    float h = height / 2.0f;
+    float d = depth / 2.0f;
+
+    // Create vertices for a cube with proper normals and texture coordinates
+    mesh.vertices = {
+        // Front face
+        {{-w, -h,  d}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f}},
+        {{ w, -h,  d}, { 0.0f,  0.0f,  1.0f}, {1.0f, 0.0f}},
+        {{ w,  h,  d}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f}},
+        {{-w,  h,  d}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f}},
+
+        // Back face
+        {{-w, -h, -d}, { 0.0f,  0.0f, -1.0f}, {0.0f, 0.0f}},
+        {{-w,  h, -d}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.0f}},
+        {{ w,  h, -d}, { 0.0f,  0.0f, -1.0f}, {1.0f, 1.0f}},
+        {{ w, -h, -d}, { 0.0f,  0.0f, -1.0f}, {0.0f, 1.0f}},
+
+        // Top face
+        {{-w,  h, -d}, { 0.0f,  1.0f,  0.0f}, {0.0f, 0.0f}},
+        {{-w,  h,  d}, { 0.0f,  1.0f,  0.0f}, {1.0f, 0.0f}},
+        {{ w,  h,  d}, { 0.0f,  1.0f,  0.0f}, {1.0f, 1.0f}},
+        {{ w,  h, -d}, { 0.0f,  1.0f,  0.0f}, {0.0f, 1.0f}},
+
+        // Bottom face
+        {{-w, -h, -d}, { 0.0f, -1.0f,  0.0f}, {0.0f, 0.0f}},
+        {{ w, -h, -d}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.0f}},
+        {{ w, -h,  d}, { 0.0f, -1.0f,  0.0f}, {1.0f, 1.0f}},
+        {{-w, -h,  d}, { 0.0f, -1.0f,  0.0f}, {0.0f, 1.0f}},
+
+        // Right face
+        {{ w, -h, -d}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
+        {{ w,  h, -d}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+        {{ w,  h,  d}, { 1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
+        {{ w, -h,  d}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
+
+        // Left face
+        {{-w, -h, -d}, {-1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
+        {{-w, -h,  d}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+        {{-w,  h,  d}, {-1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
+        {{-w,  h, -d}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}}
+    };
+
+    // Create indices for the cube faces
+    mesh.indices = {
+        // Front face
+        0, 1, 2, 2, 3, 0,
+        // Back face
+        4, 5, 6, 6, 7, 4,
+        // Top face
+        8, 9, 10, 10, 11, 8,
+        // Bottom face
+        12, 13, 14, 14, 15, 12,
+        // Right face
+        16, 17, 18, 18, 19, 16,
+        // Left face
+        20, 21, 22, 22, 23, 20
+    };
+
+    return mesh;
+}
+
+Mesh MeshGenerator::generatePlane(float width, float height) {
+    Mesh mesh;
+    
+    // Half dimensions
+    float w = width / 2.0f;
+    float h = height / 2.0f;
+
+    // Create vertices for a plane
+    mesh.vertices = {
+        {{-w, 0.0f, -h}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+        {{ w, 0.0f, -h}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+        {{ w, 0.0f,  h}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+        {{-w, 0.0f,  h}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}
+    };
+
+    // Create indices for the plane
+    mesh.indices = {
+        0, 1, 2, 2, 3, 0
+    };
+
+    return mesh;
+}
+MeshSize MeshGenerator::size(const GridShape& shape) {
+    uint64_t rows = shape.segmentsX + 1ull;
+    uint64_t columns = shape.segmentsZ + 1ull;
+    return checkedSize(rows * columns, 6ull * shape.segmentsX * shape.segmentsZ);
+}
+
+void MeshGenerator::write(const GridShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount) {
+    TRACE_SCOPE("MeshGenerator::write(grid)");
+    if (shape.segmentsX == 0 || shape.segmentsZ == 0) { throw std::runtime_error("invalid grid tessellation!"); }
+    size(shape);
+
+    // Rows run along X and columns along Z, which makes the shared quad winding face +Y
+    uint32_t rows = shape.segmentsX + 1;
+    uint32_t columns = shape.segmentsZ + 1;
+    float stepX = shape.width / static_cast<float>(shape.segmentsX);
+    float stepZ = shape.depth / static_cast<float>(shape.segmentsZ);
+    writeGrid(rows, columns, indices, baseVertex, threadCount, [&](uint32_t row) {
+        Vertex* out = vertices + static_cast<size_t>(row) * columns;
+        float x = -0.5f * shape.width + stepX * static_cast<float>(row);
+        float u = static_cast<float>(row) / static_cast<float>(shape.segmentsX);
+        for (uint32_t column = 0; column < columns; column++) {
+            out[column].position = glm::vec3(x, 0.0f, -0.5f * shape.depth + stepZ * static_cast<float>(column));
+            out[column].normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            out[column].texCoord = glm::vec2(u, static_cast<float>(column) / static_cast<float>(shape.segmentsZ));
+        }
+    });
+}
+
+MeshSize MeshGenerator::size(const UvSphereShape& shape) {
+    // Pole rows would have one degenerate triangle per quad, so they only get the other one
+    return checkedSize((shape.rings + 1ull) * (shape.segments + 1ull), 6ull * shape.segments * (shape.rings - 1ull));
+}
+
+void MeshGenerator::write(const UvSphereShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount) {
+    TRACE_SCOPE("MeshGenerator::write(uv sphere)");
+    if (shape.rings < 2 || shape.segments < 3) { throw std::runtime_error("invalid UV sphere tessellation!"); }
+    size(shape);
+
+    // Rows go from the north pole (+Y) south; every row repeats its first vertex for the texture seam
+    uint32_t rows = shape.rings + 1;
+    uint32_t columns = shape.segments + 1;
+    std::vector<glm::vec2> longitude = angleTable(shape.segments);
+
+    parallelFor(rows, minRowsPerThread(columns), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; row++) {
+            float theta = PI * static_cast<float>(row) / static_cast<float>(shape.rings);
+            // Exact poles, so all of a pole's vertices coincide
+            float sinTheta = (row == 0 || row == shape.rings) ? 0.0f : std::sin(theta);
+            float cosTheta = row == 0 ? 1.0f : (row == shape.rings ? -1.0f : std::cos(theta));
+            float v = static_cast<float>(row) / static_cast<float>(shape.rings);
+
+            Vertex* out = vertices + static_cast<size_t>(row) * columns;
+            for (uint32_t column = 0; column < columns; column++) {
+                glm::vec3 normal(sinTheta * longitude[column].x, cosTheta, sinTheta * longitude[column].y);
+                out[column].position = normal * shape.radius;
+                out[column].normal = normal;
+                out[column].texCoord = glm::vec2(static_cast<float>(column) / static_cast<float>(shape.segments), v);
+            }
+        }
+
+        for (uint32_t row = begin; row < std::min(end, shape.rings); row++) {
+            uint32_t* out = indices + (row == 0 ? 0 : 3ull * shape.segments + 6ull * shape.segments * (row - 1));
+            uint32_t rowStart = baseVertex + row * columns;
+            for (uint32_t column = 0; column < shape.segments; column++) {
+                uint32_t a = rowStart + column;
+                uint32_t b = a + 1;
+                uint32_t c = a + columns;
+                uint32_t d = c + 1;
+                if (row != 0) {
+                    out[0] = a; out[1] = b; out[2] = c;
+                    out += 3;
+                }
+                if (row != shape.rings - 1) {
+                    out[0] = b; out[1] = d; out[2] = c;
+                    out += 3;
+                }
+            }
+        }
+    }, threadCount);
+}
+
+MeshSize MeshGenerator::size(const IcoSphereShape& shape) {
+    uint64_t n = shape.frequency;
+    return checkedSize(20 * (n + 1) * (n + 2) / 2, 20 * 3 * n * n);
+}
+
+void MeshGenerator::write(const IcoSphereShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount) {
+    TRACE_SCOPE("MeshGenerator::write(ico sphere)");
+    if (shape.frequency == 0) { throw std::runtime_error("invalid ico sphere tessellation!"); }
+    size(shape);
+
+    glm::vec3 corners[12];
+    for (int i = 0; i < 12; i++) { corners[i] = glm::normalize(ICOSAHEDRON_CORNERS[i]); }
+
+    // Faces that straddle the u = 0 seam move their low u values past 1 so no triangle spans the texture
+    bool crossesSeam[20];
+    for (int face = 0; face < 20; face++) {
+        float u[3];
+        for (int k = 0; k < 3; k++) { u[k] = sphereU(corners[ICOSAHEDRON_FACES[face][k]]); }
+        crossesSeam[face] = std::max({u[0], u[1], u[2]}) - std::min({u[0], u[1], u[2]}) > 0.5f;
+    }
+
+    // Face vertex (i, j) is the normalized (n - i - j) * A + j * B + i * C: row i runs from A towards C
+    // and holds n - i + 1 vertices. Both faces of an edge weight its corners identically and the third
+    // corner by exactly 0, so edge vertices match bit for bit.
+    uint32_t n = shape.frequency;
+    size_t faceVertices = (n + 1ull) * (n + 2ull) / 2;
+    size_t faceIndices = 3ull * n * n;
+    uint32_t rowsPerFace = n + 1;
+    parallelFor(20 * rowsPerFace, minRowsPerThread(n + 1), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t item = begin; item < end; item++) {
+            uint32_t face = item / rowsPerFace;
+            uint32_t i = item % rowsPerFace;
+            const glm::vec3& a = corners[ICOSAHEDRON_FACES[face][0]];
+            const glm::vec3& b = corners[ICOSAHEDRON_FACES[face][1]];
+            const glm::vec3& c = corners[ICOSAHEDRON_FACES[face][2]];
+
+            size_t rowStart = face * faceVertices + static_cast<size_t>(i) * (n + 1) - static_cast<size_t>(i) * (i - 1) / 2;
+            size_t nextRowStart = rowStart + (n - i + 1);
+            for (uint32_t j = 0; j <= n - i; j++) {
+                glm::vec3 point = static_cast<float>(n - i - j) * a + static_cast<float>(j) * b + static_cast<float>(i) * c;
+                glm::vec3 normal = glm::normalize(point);
+                float u = sphereU(normal);
+                if (crossesSeam[face] && u < 0.5f) { u += 1.0f; }
+
+                Vertex& vertex = vertices[rowStart + j];
+                vertex.position = normal * shape.radius;
+                vertex.normal = normal;
+                vertex.texCoord = glm::vec2(u, std::acos(std::clamp(normal.y, -1.0f, 1.0f)) / PI);
+            }
+
+            if (i == n) { continue; }
+            uint32_t* out = indices + face * faceIndices + 3ull * (2ull * n * i - static_cast<size_t>(i) * i);
+            uint32_t top = baseVertex + static_cast<uint32_t>(rowStart);
+            uint32_t bottom = baseVertex + static_cast<uint32_t>(nextRowStart);
+            for (uint32_t j = 0; j < n - i; j++) {
+                out[0] = top + j; out[1] = top + j + 1; out[2] = bottom + j;
+                out += 3;
+                if (j + 1 < n - i) {
+                    out[0] = top + j + 1; out[1] = bottom + j + 1; out[2] = bottom + j;
+                    out += 3;
+                }
+            }
+        }
+    }, threadCount);
+}
+
+MeshSize MeshGenerator::size(const TorusShape& shape) {
+    return checkedSize((shape.majorSegments + 1ull) * (shape.minorSegments + 1ull),
+                       6ull * shape.majorSegments * shape.minorSegments);
+}
+
+void MeshGenerator::write(const TorusShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount) {
+    TRACE_SCOPE("MeshGenerator::write(torus)");
+    if (shape.majorSegments < 3 || shape.minorSegments < 3) { throw std::runtime_error("invalid torus tessellation!"); }
+    size(shape);
+
+    // Rows go around the major circle, columns around the tube
+    uint32_t rows = shape.majorSegments + 1;
+    uint32_t columns = shape.minorSegments + 1;
+    std::vector<glm::vec2> major = angleTable(shape.majorSegments);
+    std::vector<glm::vec2> minor = angleTable(shape.minorSegments);
+    writeGrid(rows, columns, indices, baseVertex, threadCount, [&](uint32_t row) {
+        Vertex* out = vertices + static_cast<size_t>(row) * columns;
+        glm::vec3 center = glm::vec3(major[row].x, 0.0f, major[row].y) * shape.majorRadius;
+        float u = static_cast<float>(row) / static_cast<float>(shape.majorSegments);
+        for (uint32_t column = 0; column < columns; column++) {
+            glm::vec3 normal(minor[column].x * major[row].x, minor[column].y, minor[column].x * major[row].y);
+            out[column].position = center + normal * shape.minorRadius;
+            out[column].normal = normal;
+            out[column].texCoord = glm::vec2(u, static_cast<float>(column) / static_cast<float>(shape.minorSegments));
+        }
+    });
+}
+
+MeshSize MeshGenerator::size(const CylinderShape& shape) {
+    uint64_t sideVertices = (shape.heightSegments + 1ull) * (shape.segments + 1ull);
+    uint64_t sideIndices = 6ull * shape.heightSegments * shape.segments;
+    if (!shape.capped) { return checkedSize(sideVertices, sideIndices); }
+    // Each cap is a fan around its own center vertex
+    return checkedSize(sideVertices + 2 * (shape.segments + 1ull), sideIndices + 6ull * shape.segments);
+}
+
+void MeshGenerator::write(const CylinderShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex, uint32_t threadCount) {
+    TRACE_SCOPE("MeshGenerator::write(cylinder)");
+    if (shape.segments < 3 || shape.heightSegments == 0) { throw std::runtime_error("invalid cylinder tessellation!"); }
+    size(shape);
+
+    // Side rows go from the top down
+    uint32_t rows = shape.heightSegments + 1;
+    uint32_t columns = shape.segments + 1;
+    std::vector<glm::vec2> around = angleTable(shape.segments);
+    float halfHeight = 0.5f * shape.height;
+    writeGrid(rows, columns, indices, baseVertex, threadCount, [&](uint32_t row) {
+        Vertex* out = vertices + static_cast<size_t>(row) * columns;
+        float v = static_cast<float>(row) / static_cast<float>(shape.heightSegments);
+        float y = halfHeight - shape.height * v;
+        for (uint32_t column = 0; column < columns; column++) {
+            glm::vec3 normal(around[column].x, 0.0f, around[column].y);
+            out[column].position = glm::vec3(normal.x * shape.radius, y, normal.z * shape.radius);
+            out[column].normal = normal;
+            out[column].texCoord = glm::vec2(static_cast<float>(column) / static_cast<float>(shape.segments), v);
+        }
+    });
+    if (!shape.capped) { return; }
+
+    Vertex* capVertices = vertices + static_cast<size_t>(rows) * columns;
+    uint32_t* capIndices = indices + 6ull * shape.heightSegments * shape.segments;
+    for (int cap = 0; cap < 2; cap++) {
+        float side = cap == 0 ? 1.0f : -1.0f;
+        uint32_t center = baseVertex + rows * columns + static_cast<uint32_t>(cap) * columns;
+        capVertices[0] = {{0.0f, side * halfHeight, 0.0f}, {0.0f, side, 0.0f}, {0.5f, 0.5f}};
+        for (uint32_t segment = 0; segment < shape.segments; segment++) {
+            const glm::vec2& direction = around[segment];
+            capVertices[segment + 1] = {{direction.x * shape.radius, side * halfHeight, direction.y * shape.radius},
+                                        {0.0f, side, 0.0f},
+                                        {0.5f + 0.5f * direction.x, 0.5f + 0.5f * direction.y}};
+
+            uint32_t current = center + 1 + segment;
+            uint32_t next = center + 1 + (segment + 1) % shape.segments;
+            // Counter-clockwise seen from above for the top cap, from below for the bottom one
+            capIndices[0] = center;
+            capIndices[1] = cap == 0 ? next : current;
+            capIndices[2] = cap == 0 ? current : next;
+            capIndices += 3;
+        }
+        capVertices += columns;
+    }
+}
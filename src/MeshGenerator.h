@@ -0,0 +1,87 @@
+#ifndef MESH_GENERATOR_H
+#define MESH_GENERATOR_H
+
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Tessellated shapes. All of them are centered on the origin, wound counter-clockwise when seen from
+// outside and have texture coordinates in [0, 1] (the ico sphere wraps past 1 across its seam).
+
+// Subdivided plane in XZ facing +Y
+struct GridShape {
+    float width = 1.0f;
+    float depth = 1.0f;
+    uint32_t segmentsX = 1;
+    uint32_t segmentsZ = 1;
+};
+
+// Latitude/longitude sphere around Y; rings >= 2, segments >= 3
+struct UvSphereShape {
+    float radius = 0.5f;
+    uint32_t rings = 16;
+    uint32_t segments = 32;
+};
+
+// Geodesic sphere: every icosahedron face split into frequency^2 triangles. Faces do not share vertices,
+// but shared edges get bit-identical positions, so the surface is watertight.
+struct IcoSphereShape {
+    float radius = 0.5f;
+    uint32_t frequency = 8;
+};
+
+// Torus around Y
+struct TorusShape {
+    float majorRadius = 0.35f;
+    float minorRadius = 0.15f;
+    uint32_t majorSegments = 48;
+    uint32_t minorSegments = 24;
+};
+
+// Cylinder around Y, optionally closed with flat caps
+struct CylinderShape {
+    float radius = 0.5f;
+    float height = 1.0f;
+    uint32_t segments = 32;
+    uint32_t heightSegments = 1;
+    bool capped = true;
+};
+
+// Vertex and index counts of a shape, for sizing the destination before MeshGenerator::write()
+struct MeshSize {
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+};
+
+class MeshGenerator {
+public:
+    static Mesh generateCube(float width, float height, float depth);
+    static Mesh generatePlane(float width, float height);
+
+    static MeshSize size(const GridShape& shape);
+    static MeshSize size(const UvSphereShape& shape);
+    static MeshSize size(const IcoSphereShape& shape);
+    static MeshSize size(const TorusShape& shape);
+    static MeshSize size(const CylinderShape& shape);
+
+    // Write size(shape) vertices and indices straight into caller-owned memory (a mesh's vectors, a
+    // mapped staging buffer, ...), split by rows across up to threadCount threads (0 = hardware
+    // concurrency). Indices are offset by baseVertex, so several shapes can share one buffer.
+    static void write(const GridShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex = 0, uint32_t threadCount = 0);
+    static void write(const UvSphereShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex = 0, uint32_t threadCount = 0);
+    static void write(const IcoSphereShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex = 0, uint32_t threadCount = 0);
+    static void write(const TorusShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex = 0, uint32_t threadCount = 0);
+    static void write(const CylinderShape& shape, Vertex* vertices, uint32_t* indices, uint32_t baseVertex = 0, uint32_t threadCount = 0);
+
+    template <typename Shape>
+    static Mesh generate(const Shape& shape, uint32_t threadCount = 0) {
+        MeshSize meshSize = size(shape);
+        Mesh mesh;
+        mesh.vertices.resize(meshSize.vertexCount);
+        mesh.indices.resize(meshSize.indexCount);
+        write(shape, mesh.vertices.data(), mesh.indices.data(), 0, threadCount);
+        return mesh;
+    }
+};
+
+#endif // MESH_GENERATOR_H
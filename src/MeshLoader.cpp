@@ -0,0 +1,881 @@
+#include "MeshLoader.h"
+#include "DenseKeyTable.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// ---- Shared helpers ----
+
+uint32_t resolveThreadCount(uint32_t threadCount) {
+    return threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount;
+}
+
+// Area-weighted normals for the vertices flagged in needsNormal, from the triangles that use them
+void computeMissingNormals(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<uint8_t>& needsNormal) {
+    TRACE_SCOPE("computeMissingNormals");
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (needsNormal[i]) { vertices[i].normal = glm::vec3(0.0f); }
+    }
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (!needsNormal[a] && !needsNormal[b] && !needsNormal[c]) { continue; }
+        // The cross product's length is twice the triangle area, which weights the sum
+        glm::vec3 faceNormal = glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+        if (needsNormal[a]) { vertices[a].normal += faceNormal; }
+        if (needsNormal[b]) { vertices[b].normal += faceNormal; }
+        if (needsNormal[c]) { vertices[c].normal += faceNormal; }
+    }
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (!needsNormal[i]) { continue; }
+        float length = glm::length(vertices[i].normal);
+        vertices[i].normal = length > 0.0f ? vertices[i].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+}
+
+// ---- OBJ ----
+
+// Chunks are at least this large so per-chunk overhead stays negligible
+constexpr size_t MIN_OBJ_CHUNK_BYTES = 1 << 20;
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+void skipBlanks(const char*& p, const char* end) {
+    while (p < end && isBlank(*p)) { p++; }
+}
+
+void skipLine(const char*& p, const char* end) {
+    while (p < end && *p != '\n') { p++; }
+    if (p < end) { p++; }
+}
+
+// Locale-independent decimal parser, much faster than strtof; accurate to about one float ulp
+bool parseFloat(const char*& p, const char* end, float& value) {
+    static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                           1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    skipBlanks(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) { negative = *p++ == '-'; }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (mantissa < 100000000000000000ull) { mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0'); }
+        else { exponent++; }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) {
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* exponentStart = p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) { negativeExponent = *p++ == '-'; }
+        if (p < end && *p >= '0' && *p <= '9') {
+            int explicitExponent = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++) { explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 1000); }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        } else {
+            p = exponentStart;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    int magnitude = std::abs(exponent);
+    double scale = magnitude <= 18 ? POWERS_OF_TEN[magnitude] : std::pow(10.0, magnitude);
+    result = exponent < 0 ? result / scale : result * scale;
+    value = static_cast<float>(negative ? -result : result);
+    return true;
+}
+
+bool parseInt(const char*& p, const char* end, int64_t& value) {
+    bool negative = false;
+    const char* start = p;
+    if (p < end && (*p == '-' || *p == '+')) { negative = *p++ == '-'; }
+    if (p >= end || *p < '0' || *p > '9') {
+        p = start;
+        return false;
+    }
+    int64_t result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) { result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX); }
+    value = negative ? -result : result;
+    return true;
+}
+
+// One v/vt/vn corner. Positive OBJ indices are stored 0-based and absolute; negative ones are relative to
+// the chunk start until the counts of the preceding chunks are known. Missing vt/vn are INT32_MIN.
+struct ObjCorner {
+    int32_t position;
+    int32_t texCoord;
+    int32_t normal;
+    // Bit k set: component k is chunk relative
+    uint32_t relative;
+};
+
+constexpr int32_t MISSING = INT32_MIN;
+
+// Fully resolved corner, the deduplication key
+struct ObjKey {
+    int32_t position;
+    int32_t texCoord;
+    int32_t normal;
+
+    bool operator==(const ObjKey& other) const {
+        return position == other.position && texCoord == other.texCoord && normal == other.normal;
+    }
+};
+
+uint64_t hashKey(const ObjKey& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hashCombine(hash, static_cast<uint32_t>(key.position));
+    hash = hashCombine(hash, static_cast<uint32_t>(key.texCoord));
+    return hashCombine(hash, static_cast<uint32_t>(key.normal));
+}
+
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    // Three per triangle
+    std::vector<ObjCorner> corners;
+
+    // Counts of the preceding chunks, for resolving indices
+    size_t positionBase = 0;
+    size_t normalBase = 0;
+    size_t texCoordBase = 0;
+    size_t indexBase = 0;
+
+    // Corners deduplicated within the chunk, in first-use order, and each corner's unique slot
+    std::vector<ObjKey> uniqueKeys;
+    std::vector<uint64_t> uniqueHashes;
+    std::vector<uint32_t> cornerSlots;
+    // Per unique key: the (chunk << 32 | slot) that first used it anywhere in the file, then its vertex
+    std::vector<uint64_t> owners;
+    std::vector<uint32_t> vertexIds;
+    uint32_t ownedCount = 0;
+};
+
+void parseObjChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+    std::vector<ObjCorner> polygon;
+
+    while (p < end) {
+        skipBlanks(p, end);
+        if (p + 1 >= end) { break; }
+
+        if (p[0] == 'v' && isBlank(p[1])) {
+            p += 2;
+            glm::vec3 position(0.0f);
+            parseFloat(p, end, position.x);
+            parseFloat(p, end, position.y);
+            parseFloat(p, end, position.z);
+            chunk.positions.push_back(position);
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            p += 2;
+            glm::vec3 normal(0.0f);
+            parseFloat(p, end, normal.x);
+            parseFloat(p, end, normal.y);
+            parseFloat(p, end, normal.z);
+            chunk.normals.push_back(normal);
+        } else if (p[0] == 'v' && p[1] == 't') {
+            p += 2;
+            glm::vec2 texCoord(0.0f);
+            parseFloat(p, end, texCoord.x);
+            parseFloat(p, end, texCoord.y);
+            chunk.texCoords.push_back(glm::vec2(texCoord.x, 1.0f - texCoord.y));
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            p += 2;
+            polygon.clear();
+            while (true) {
+                skipBlanks(p, end);
+                int64_t values[3] = {0, MISSING, MISSING};
+                if (!parseInt(p, end, values[0])) { break; }
+                for (int k = 1; k < 3 && p < end && *p == '/'; k++) {
+                    p++;
+                    parseInt(p, end, values[k]);
+                }
+
+                ObjCorner corner{};
+                int64_t counts[3] = {static_cast<int64_t>(chunk.positions.size()), static_cast<int64_t>(chunk.texCoords.size()),
+                                     static_cast<int64_t>(chunk.normals.size())};
+                int32_t* fields[3] = {&corner.position, &corner.texCoord, &corner.normal};
+                for (int k = 0; k < 3; k++) {
+                    if (values[k] == MISSING) { *fields[k] = MISSING; }
+                    else if (values[k] > 0) { *fields[k] = static_cast<int32_t>(values[k] - 1); }
+                    else if (values[k] < 0) {
+                        *fields[k] = static_cast<int32_t>(counts[k] + values[k]);
+                        corner.relative |= 1u << k;
+                    } else {
+                        throw std::runtime_error("OBJ index 0 is invalid!");
+                    }
+                }
+                polygon.push_back(corner);
+            }
+            for (size_t k = 2; k < polygon.size(); k++) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[k - 1]);
+                chunk.corners.push_back(polygon[k]);
+            }
+        }
+        skipLine(p, end);
+    }
+}
+
+ObjKey resolveCorner(const ObjChunk& chunk, const ObjCorner& corner, size_t positionCount, size_t texCoordCount, size_t normalCount) {
+    auto resolve = [&](int32_t value, uint32_t bit, size_t base, size_t count) -> int32_t {
+        if (value == MISSING) { return -1; }
+        int64_t absolute = (corner.relative & bit) ? static_cast<int64_t>(base) + value : value;
+        if (absolute < 0 || absolute >= static_cast<int64_t>(count)) { throw std::runtime_error("OBJ face index out of range!"); }
+        return static_cast<int32_t>(absolute);
+    };
+    return {resolve(corner.position, 1u, chunk.positionBase, positionCount),
+            resolve(corner.texCoord, 2u, chunk.texCoordBase, texCoordCount),
+            resolve(corner.normal, 4u, chunk.normalBase, normalCount)};
+}
+
+// ---- glTF ----
+
+// Just enough JSON for glTF: a DOM with objects kept as ordered key/value lists
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    [[nodiscard]] const JsonValue* find(const char* key) const {
+        for (const auto& member : object) {
+            if (member.first == key) { return &member.second; }
+        }
+        return nullptr;
+    }
+    [[nodiscard]] double numberOr(const char* key, double fallback) const {
+        const JsonValue* value = find(key);
+        return value != nullptr && value->type == Type::Number ? value->number : fallback;
+    }
+    [[nodiscard]] const JsonValue& at(size_t index) const {
+        if (type != Type::Array || index >= array.size()) { throw std::runtime_error("glTF index out of range!"); }
+        return array[index];
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* text, size_t size) : p(text), end(text + size) {}
+
+    JsonValue parseDocument() {
+        JsonValue value = parseValue(0);
+        skipWhitespace();
+        if (p != end) { fail(); }
+        return value;
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 128;
+    const char* p;
+    const char* end;
+
+    [[noreturn]] static void fail() { throw std::runtime_error("malformed glTF JSON!"); }
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) { p++; }
+    }
+
+    void expect(char c) {
+        skipWhitespace();
+        if (p >= end || *p != c) { fail(); }
+        p++;
+    }
+
+    bool consumeLiteral(const char* literal) {
+        size_t length = std::strlen(literal);
+        if (static_cast<size_t>(end - p) < length || std::memcmp(p, literal, length) != 0) { return false; }
+        p += length;
+        return true;
+    }
+
+    JsonValue parseValue(int depth) {
+        if (depth > MAX_DEPTH) { fail(); }
+        skipWhitespace();
+        if (p >= end) { fail(); }
+
+        JsonValue value;
+        if (*p == '{') {
+            value.type = JsonValue::Type::Object;
+            p++;
+            skipWhitespace();
+            if (p < end && *p == '}') { p++; return value; }
+            while (true) {
+                skipWhitespace();
+                std::string key = parseString();
+                expect(':');
+                value.object.emplace_back(std::move(key), parseValue(depth + 1));
+                skipWhitespace();
+                if (p < end && *p == ',') { p++; continue; }
+                expect('}');
+                return value;
+            }
+        }
+        if (*p == '[') {
+            value.type = JsonValue::Type::Array;
+            p++;
+            skipWhitespace();
+            if (p < end && *p == ']') { p++; return value; }
+            while (true) {
+                value.array.push_back(parseValue(depth + 1));
+                skipWhitespace();
+                if (p < end && *p == ',') { p++; continue; }
+                expect(']');
+                return value;
+            }
+        }
+        if (*p == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+            return value;
+        }
+        if (consumeLiteral("true")) { value.type = JsonValue::Type::Bool; value.boolean = true; return value; }
+        if (consumeLiteral("false")) { value.type = JsonValue::Type::Bool; return value; }
+        if (consumeLiteral("null")) { return value; }
+
+        // JSON numbers are a subset of what strtod accepts; copy the token so strtod cannot run past it
+        const char* start = p;
+        while (p < end && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) { p++; }
+        if (p == start) { fail(); }
+        std::string token(start, p);
+        char* parsedEnd = nullptr;
+        value.type = JsonValue::Type::Number;
+        value.number = std::strtod(token.c_str(), &parsedEnd);
+        if (parsedEnd != token.c_str() + token.size()) { fail(); }
+        return value;
+    }
+
+    std::string parseString() {
+        if (p >= end || *p != '"') { fail(); }
+        p++;
+        std::string result;
+        while (true) {
+            if (p >= end) { fail(); }
+            char c = *p++;
+            if (c == '"') { return result; }
+            if (c != '\\') { result += c; continue; }
+            if (p >= end) { fail(); }
+            char escape = *p++;
+            switch (escape) {
+                case '"': case '\\': case '/': result += escape; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u': {
+                    if (end - p < 4) { fail(); }
+                    // Exactly four hex digits; anything else is malformed rather than a shorter code
+                    uint32_t code = 0;
+                    for (int digit = 0; digit < 4; digit++) {
+                        char h = *p++;
+                        code <<= 4;
+                        if (h >= '0' && h <= '9') { code |= static_cast<uint32_t>(h - '0'); }
+                        else if (h >= 'a' && h <= 'f') { code |= static_cast<uint32_t>(h - 'a' + 10); }
+                        else if (h >= 'A' && h <= 'F') { code |= static_cast<uint32_t>(h - 'A' + 10); }
+                        else { fail(); }
+                    }
+                    // Names only matter for lookups, so surrogate pairs are encoded one half at a time
+                    if (code < 0x80) { result += static_cast<char>(code); }
+                    else if (code < 0x800) {
+                        result += static_cast<char>(0xC0 | (code >> 6));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        result += static_cast<char>(0xE0 | (code >> 12));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: fail();
+            }
+        }
+    }
+};
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+constexpr int GLTF_MODE_TRIANGLES = 4;
+
+uint32_t readU32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// A typed view of one accessor inside the BIN chunk
+struct GltfAccessor {
+    const char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    uint32_t componentType = 0;
+    uint32_t componentCount = 0;
+    bool normalized = false;
+
+    // Reads component k of element i as float, applying glTF's normalization rules
+    [[nodiscard]] float read(size_t i, uint32_t k) const {
+        const char* element = data + i * stride;
+        switch (componentType) {
+            case 5126: { float v; std::memcpy(&v, element + k * 4, 4); return v; }
+            case 5121: { uint8_t v = static_cast<uint8_t>(element[k]); return normalized ? v / 255.0f : v; }
+            case 5123: { uint16_t v; std::memcpy(&v, element + k * 2, 2); return normalized ? v / 65535.0f : v; }
+            case 5120: { int8_t v = static_cast<int8_t>(element[k]); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+            case 5122: { int16_t v; std::memcpy(&v, element + k * 2, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+            case 5125: { uint32_t v; std::memcpy(&v, element + k * 4, 4); return static_cast<float>(v); }
+            default: throw std::runtime_error("unsupported glTF component type!");
+        }
+    }
+
+    [[nodiscard]] uint32_t readIndex(size_t i) const {
+        const char* element = data + i * stride;
+        switch (componentType) {
+            case 5121: return static_cast<uint8_t>(element[0]);
+            case 5123: { uint16_t v; std::memcpy(&v, element, 2); return v; }
+            case 5125: { uint32_t v; std::memcpy(&v, element, 4); return v; }
+            default: throw std::runtime_error("unsupported glTF index type!");
+        }
+    }
+};
+
+uint32_t componentSize(uint32_t componentType) {
+    switch (componentType) {
+        case 5120: case 5121: return 1;
+        case 5122: case 5123: return 2;
+        case 5125: case 5126: return 4;
+        default: throw std::runtime_error("unsupported glTF component type!");
+    }
+}
+
+uint32_t typeComponentCount(const std::string& type) {
+    if (type == "SCALAR") { return 1; }
+    if (type == "VEC2") { return 2; }
+    if (type == "VEC3") { return 3; }
+    if (type == "VEC4") { return 4; }
+    if (type == "MAT4") { return 16; }
+    throw std::runtime_error("unsupported glTF accessor type: " + type);
+}
+
+GltfAccessor getAccessor(const JsonValue& root, size_t index, const char* bin, size_t binSize) {
+    const JsonValue* accessors = root.find("accessors");
+    const JsonValue* bufferViews = root.find("bufferViews");
+    if (accessors == nullptr || bufferViews == nullptr) { throw std::runtime_error("glTF file has no accessors!"); }
+    const JsonValue& accessor = accessors->at(index);
+    if (accessor.find("sparse") != nullptr) { throw std::runtime_error("sparse glTF accessors are not supported!"); }
+    const JsonValue* viewIndex = accessor.find("bufferView");
+    if (viewIndex == nullptr) { throw std::runtime_error("glTF accessors without a buffer view are not supported!"); }
+    const JsonValue& view = bufferViews->at(static_cast<size_t>(viewIndex->number));
+    if (view.numberOr("buffer", 0.0) != 0.0 || bin == nullptr) { throw std::runtime_error("only the embedded GLB buffer is supported!"); }
+
+    const JsonValue* type = accessor.find("type");
+    GltfAccessor result;
+    result.componentType = static_cast<uint32_t>(accessor.numberOr("componentType", 0.0));
+    result.componentCount = typeComponentCount(type != nullptr ? type->string : "");
+    result.count = static_cast<size_t>(accessor.numberOr("count", 0.0));
+    const JsonValue* normalized = accessor.find("normalized");
+    result.normalized = normalized != nullptr && normalized->boolean;
+
+    size_t elementSize = static_cast<size_t>(componentSize(result.componentType)) * result.componentCount;
+    result.stride = static_cast<size_t>(view.numberOr("byteStride", 0.0));
+    if (result.stride == 0) { result.stride = elementSize; }
+
+    size_t viewOffset = static_cast<size_t>(view.numberOr("byteOffset", 0.0));
+    size_t viewLength = static_cast<size_t>(view.numberOr("byteLength", 0.0));
+    size_t offset = static_cast<size_t>(accessor.numberOr("byteOffset", 0.0));
+    if (viewOffset + viewLength > binSize || (result.count > 0 && offset + (result.count - 1) * result.stride + elementSize > viewLength)) {
+        throw std::runtime_error("glTF accessor exceeds its buffer!");
+    }
+    result.data = bin + viewOffset + offset;
+    return result;
+}
+
+glm::mat4 nodeTransform(const JsonValue& node) {
+    if (const JsonValue* matrix = node.find("matrix")) {
+        glm::mat4 result(1.0f);
+        for (int i = 0; i < 16; i++) { result[i / 4][i % 4] = static_cast<float>(matrix->at(static_cast<size_t>(i)).number); }
+        return result;
+    }
+
+    glm::mat4 translation(1.0f), rotation(1.0f), scale(1.0f);
+    if (const JsonValue* t = node.find("translation")) {
+        translation[3] = glm::vec4(static_cast<float>(t->at(0).number), static_cast<float>(t->at(1).number), static_cast<float>(t->at(2).number), 1.0f);
+    }
+    if (const JsonValue* r = node.find("rotation")) {
+        float x = static_cast<float>(r->at(0).number), y = static_cast<float>(r->at(1).number);
+        float z = static_cast<float>(r->at(2).number), w = static_cast<float>(r->at(3).number);
+        rotation[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f);
+        rotation[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f);
+        rotation[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f);
+    }
+    if (const JsonValue* s = node.find("scale")) {
+        scale[0][0] = static_cast<float>(s->at(0).number);
+        scale[1][1] = static_cast<float>(s->at(1).number);
+        scale[2][2] = static_cast<float>(s->at(2).number);
+    }
+    return translation * rotation * scale;
+}
+
+// A primitive placed in the scene, with the ranges it will occupy in the merged mesh
+struct GltfDraw {
+    const JsonValue* primitive = nullptr;
+    glm::mat4 transform = glm::mat4(1.0f);
+    size_t firstVertex = 0;
+    size_t vertexCount = 0;
+    size_t firstIndex = 0;
+    size_t indexCount = 0;
+};
+
+void collectDraws(const JsonValue& root, size_t nodeIndex, const glm::mat4& parent, std::vector<GltfDraw>& draws, int depth) {
+    if (depth > 64) { throw std::runtime_error("glTF node hierarchy is too deep or cyclic!"); }
+    const JsonValue* nodes = root.find("nodes");
+    if (nodes == nullptr) { throw std::runtime_error("glTF scene references missing nodes!"); }
+    const JsonValue& node = nodes->at(nodeIndex);
+    glm::mat4 transform = parent * nodeTransform(node);
+
+    if (const JsonValue* meshIndex = node.find("mesh")) {
+        const JsonValue* meshes = root.find("meshes");
+        if (meshes == nullptr) { throw std::runtime_error("glTF node references missing meshes!"); }
+        const JsonValue* primitives = meshes->at(static_cast<size_t>(meshIndex->number)).find("primitives");
+        if (primitives == nullptr) { throw std::runtime_error("glTF mesh has no primitives!"); }
+        for (const JsonValue& primitive : primitives->array) {
+            if (static_cast<int>(primitive.numberOr("mode", GLTF_MODE_TRIANGLES)) != GLTF_MODE_TRIANGLES) { continue; }
+            GltfDraw draw;
+            draw.primitive = &primitive;
+            draw.transform = transform;
+            draws.push_back(draw);
+        }
+    }
+    if (const JsonValue* children = node.find("children")) {
+        for (const JsonValue& child : children->array) { collectDraws(root, static_cast<size_t>(child.number), transform, draws, depth + 1); }
+    }
+}
+
+} // namespace
+
+Mesh MeshLoader::load(const std::string& path, uint32_t threadCount) {
+    TRACE_SCOPE("MeshLoader::load");
+    std::string extension = path.substr(path.find_last_of('.') == std::string::npos ? path.size() : path.find_last_of('.'));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    MappedFile file(path);
+    // The parsers only see the bytes, so their errors get the file name here
+    try {
+        if (extension == ".obj") { return parseObj(file.data(), file.size(), threadCount); }
+        if (extension == ".glb") { return parseGlb(file.data(), file.size(), threadCount); }
+    } catch (const std::runtime_error& error) {
+        throw std::runtime_error(path + ": " + error.what());
+    }
+    throw std::runtime_error("unsupported mesh file format: " + path);
+}
+
+Mesh MeshLoader::parseObj(const char* text, size_t size, uint32_t threadCount) {
+    TRACE_SCOPE("MeshLoader::parseObj");
+    threadCount = resolveThreadCount(threadCount);
+
+    // Several chunks per thread even out lines of different cost (faces vs. positions)
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_OBJ_CHUNK_BYTES, threadCount * 4ull));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* fileEnd = text + size;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const char* begin = text + size * c / chunkCount;
+        // Every chunk but the first starts after the line break that ends its predecessor's last line
+        if (c > 0) {
+            while (begin < fileEnd && begin[-1] != '\n') { begin++; }
+        }
+        chunks[c].begin = begin;
+        if (c > 0) { chunks[c - 1].end = begin; }
+    }
+    chunks.back().end = fileEnd;
+
+    auto forEachChunk = [&](const std::function<void(ObjChunk&, uint32_t)>& body) {
+        parallelFor(static_cast<uint32_t>(chunkCount), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t c = begin; c < end; c++) { body(chunks[c], c); }
+        }, threadCount);
+    };
+
+    {
+        TRACE_SCOPE("parse chunks");
+        forEachChunk([](ObjChunk& chunk, uint32_t) { parseObjChunk(chunk); });
+    }
+
+    size_t positionCount = 0, texCoordCount = 0, normalCount = 0, indexCount = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.normalBase = normalCount;
+        chunk.indexBase = indexCount;
+        positionCount += chunk.positions.size();
+        texCoordCount += chunk.texCoords.size();
+        normalCount += chunk.normals.size();
+        indexCount += chunk.corners.size();
+    }
+    if (indexCount > UINT32_MAX) { throw std::runtime_error("OBJ file has too many faces!"); }
+
+    // Attributes are only addressed through the chunk that declared them, so gather them into one array
+    std::vector<glm::vec3> positions(positionCount), normals(normalCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    {
+        TRACE_SCOPE("deduplicate chunks");
+        forEachChunk([&](ObjChunk& chunk, uint32_t) {
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + static_cast<std::ptrdiff_t>(chunk.positionBase));
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + static_cast<std::ptrdiff_t>(chunk.normalBase));
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + static_cast<std::ptrdiff_t>(chunk.texCoordBase));
+            std::vector<glm::vec3>().swap(chunk.positions);
+            std::vector<glm::vec3>().swap(chunk.normals);
+            std::vector<glm::vec2>().swap(chunk.texCoords);
+
+            DenseKeyTable<ObjKey> table(chunk.corners.size() / 4);
+            chunk.cornerSlots.resize(chunk.corners.size());
+            for (size_t i = 0; i < chunk.corners.size(); i++) {
+                ObjKey key = resolveCorner(chunk, chunk.corners[i], positionCount, texCoordCount, normalCount);
+                bool inserted = false;
+                chunk.cornerSlots[i] = table.findOrInsert(key, hashKey(key), inserted);
+            }
+            std::vector<ObjCorner>().swap(chunk.corners);
+            chunk.uniqueKeys = std::move(table.keys);
+            chunk.uniqueHashes = std::move(table.hashes);
+            chunk.owners.resize(chunk.uniqueKeys.size());
+        });
+    }
+
+    // Merge: a shard owns the keys whose hash selects it and walks the chunks in file order, so the
+    // owner of each key is its first use in the file no matter how the work is scheduled
+    {
+        TRACE_SCOPE("merge shards");
+        uint32_t shardCount = threadCount;
+        size_t uniqueTotal = 0;
+        for (const ObjChunk& chunk : chunks) { uniqueTotal += chunk.uniqueKeys.size(); }
+        parallelFor(shardCount, 1, [&](uint32_t shardBegin, uint32_t shardEnd) {
+            for (uint32_t shard = shardBegin; shard < shardEnd; shard++) {
+                DenseKeyTable<ObjKey> table(uniqueTotal / shardCount);
+                std::vector<uint64_t> tableOwners;
+                for (size_t c = 0; c < chunkCount; c++) {
+                    ObjChunk& chunk = chunks[c];
+                    for (size_t slot = 0; slot < chunk.uniqueKeys.size(); slot++) {
+                        // The table indexes with the low hash bits, so shards are picked with the high ones
+                        if ((chunk.uniqueHashes[slot] >> 40) % shardCount != shard) { continue; }
+                        bool inserted = false;
+                        uint32_t entry = table.findOrInsert(chunk.uniqueKeys[slot], chunk.uniqueHashes[slot], inserted);
+                        if (inserted) { tableOwners.push_back(static_cast<uint64_t>(c) << 32 | slot); }
+                        chunk.owners[slot] = tableOwners[entry];
+                    }
+                }
+            }
+        }, threadCount);
+    }
+
+    // Number the owned keys in file order, then give every key its owner's vertex
+    size_t vertexCount = 0;
+    forEachChunk([](ObjChunk& chunk, uint32_t c) {
+        for (size_t slot = 0; slot < chunk.owners.size(); slot++) {
+            if (chunk.owners[slot] == (static_cast<uint64_t>(c) << 32 | slot)) { chunk.ownedCount++; }
+        }
+    });
+    std::vector<size_t> vertexBases(chunkCount);
+    for (size_t c = 0; c < chunkCount; c++) {
+        vertexBases[c] = vertexCount;
+        vertexCount += chunks[c].ownedCount;
+    }
+    if (vertexCount > UINT32_MAX) { throw std::runtime_error("OBJ file has too many vertices!"); }
+
+    Mesh mesh;
+    mesh.vertices.resize(vertexCount);
+    mesh.indices.resize(indexCount);
+    std::vector<uint8_t> needsNormal(vertexCount, 0);
+    std::atomic<bool> anyMissingNormal{false};
+    {
+        TRACE_SCOPE("emit vertices");
+        forEachChunk([&](ObjChunk& chunk, uint32_t c) {
+            uint32_t next = static_cast<uint32_t>(vertexBases[c]);
+            chunk.vertexIds.resize(chunk.uniqueKeys.size());
+            for (size_t slot = 0; slot < chunk.uniqueKeys.size(); slot++) {
+                if (chunk.owners[slot] != (static_cast<uint64_t>(c) << 32 | slot)) { continue; }
+                const ObjKey& key = chunk.uniqueKeys[slot];
+                Vertex& vertex = mesh.vertices[next];
+                vertex.position = positions[static_cast<size_t>(key.position)];
+                vertex.texCoord = key.texCoord >= 0 ? texCoords[static_cast<size_t>(key.texCoord)] : glm::vec2(0.0f);
+                if (key.normal >= 0) { vertex.normal = normals[static_cast<size_t>(key.normal)]; }
+                else {
+                    needsNormal[next] = 1;
+                    anyMissingNormal = true;
+                }
+                chunk.vertexIds[slot] = next++;
+            }
+        });
+        // Owners may sit in earlier chunks, so their ids must all exist before anyone looks them up
+        forEachChunk([&](ObjChunk& chunk, uint32_t c) {
+            for (size_t slot = 0; slot < chunk.uniqueKeys.size(); slot++) {
+                uint64_t owner = chunk.owners[slot];
+                if (owner != (static_cast<uint64_t>(c) << 32 | slot)) {
+                    chunk.vertexIds[slot] = chunks[owner >> 32].vertexIds[owner & 0xFFFFFFFFu];
+                }
+            }
+        });
+        forEachChunk([&](ObjChunk& chunk, uint32_t) {
+            uint32_t* out = mesh.indices.data() + chunk.indexBase;
+            for (size_t i = 0; i < chunk.cornerSlots.size(); i++) { out[i] = chunk.vertexIds[chunk.cornerSlots[i]]; }
+        });
+    }
+
+    if (anyMissingNormal) { computeMissingNormals(mesh.vertices, mesh.indices, needsNormal); }
+    return mesh;
+}
+
+Mesh MeshLoader::parseGlb(const char* data, size_t size, uint32_t threadCount) {
+    TRACE_SCOPE("MeshLoader::parseGlb");
+    if (size < 12 || readU32(data) != GLB_MAGIC) { throw std::runtime_error("not a binary glTF file!"); }
+    if (readU32(data + 4) != 2) { throw std::runtime_error("unsupported glTF version!"); }
+    size = std::min<size_t>(size, readU32(data + 8));
+
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    const char* bin = nullptr;
+    size_t binSize = 0;
+    for (size_t offset = 12; offset + 8 <= size;) {
+        size_t chunkSize = readU32(data + offset);
+        uint32_t chunkType = readU32(data + offset + 4);
+        if (offset + 8 + chunkSize > size) { throw std::runtime_error("truncated GLB chunk!"); }
+        if (chunkType == GLB_CHUNK_JSON && json == nullptr) { json = data + offset + 8; jsonSize = chunkSize; }
+        else if (chunkType == GLB_CHUNK_BIN && bin == nullptr) { bin = data + offset + 8; binSize = chunkSize; }
+        offset += 8 + ((chunkSize + 3) & ~size_t(3));
+    }
+    if (json == nullptr) { throw std::runtime_error("GLB file has no JSON chunk!"); }
+    JsonValue root = JsonParser(json, jsonSize).parseDocument();
+
+    // Flatten the default scene (or every root-level mesh when there is none) into placed primitives
+    std::vector<GltfDraw> draws;
+    const JsonValue* scenes = root.find("scenes");
+    if (scenes != nullptr && !scenes->array.empty()) {
+        const JsonValue& scene = scenes->at(static_cast<size_t>(root.numberOr("scene", 0.0)));
+        if (const JsonValue* nodes = scene.find("nodes")) {
+            for (const JsonValue& node : nodes->array) { collectDraws(root, static_cast<size_t>(node.number), glm::mat4(1.0f), draws, 0); }
+        }
+    } else if (const JsonValue* meshes = root.find("meshes")) {
+        for (const JsonValue& mesh : meshes->array) {
+            const JsonValue* primitives = mesh.find("primitives");
+            if (primitives == nullptr) { throw std::runtime_error("glTF mesh has no primitives!"); }
+            for (const JsonValue& primitive : primitives->array) {
+                if (static_cast<int>(primitive.numberOr("mode", GLTF_MODE_TRIANGLES)) != GLTF_MODE_TRIANGLES) { continue; }
+                GltfDraw draw;
+                draw.primitive = &primitive;
+                draws.push_back(draw);
+            }
+        }
+    }
+
+    // Size everything first so the mesh is allocated once and primitives are written in place
+    size_t vertexCount = 0, indexCount = 0;
+    for (GltfDraw& draw : draws) {
+        const JsonValue* attributes = draw.primitive->find("attributes");
+        const JsonValue* position = attributes != nullptr ? attributes->find("POSITION") : nullptr;
+        if (position == nullptr) { throw std::runtime_error("glTF primitive has no positions!"); }
+        draw.vertexCount = getAccessor(root, static_cast<size_t>(position->number), bin, binSize).count;
+        const JsonValue* indices = draw.primitive->find("indices");
+        draw.indexCount = indices != nullptr ? getAccessor(root, static_cast<size_t>(indices->number), bin, binSize).count : draw.vertexCount;
+        draw.indexCount -= draw.indexCount % 3;
+        draw.firstVertex = vertexCount;
+        draw.firstIndex = indexCount;
+        vertexCount += draw.vertexCount;
+        indexCount += draw.indexCount;
+    }
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) { throw std::runtime_error("glTF file is too large for 32-bit indices!"); }
+
+    Mesh mesh;
+    mesh.vertices.resize(vertexCount);
+    mesh.indices.resize(indexCount);
+    std::vector<uint8_t> needsNormal;
+
+    for (const GltfDraw& draw : draws) {
+        const JsonValue& attributes = *draw.primitive->find("attributes");
+        GltfAccessor positions = getAccessor(root, static_cast<size_t>(attributes.find("POSITION")->number), bin, binSize);
+        const JsonValue* normalIndex = attributes.find("NORMAL");
+        const JsonValue* texCoordIndex = attributes.find("TEXCOORD_0");
+        GltfAccessor normals, texCoords;
+        if (normalIndex != nullptr) { normals = getAccessor(root, static_cast<size_t>(normalIndex->number), bin, binSize); }
+        if (texCoordIndex != nullptr) { texCoords = getAccessor(root, static_cast<size_t>(texCoordIndex->number), bin, binSize); }
+        if (positions.componentCount != 3 || (normalIndex != nullptr && (normals.componentCount != 3 || normals.count < positions.count))
+            || (texCoordIndex != nullptr && (texCoords.componentCount != 2 || texCoords.count < positions.count))) {
+            throw std::runtime_error("glTF vertex attributes have unexpected layouts!");
+        }
+
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(draw.transform)));
+        Vertex* vertices = mesh.vertices.data() + draw.firstVertex;
+        parallelFor(static_cast<uint32_t>(draw.vertexCount), 16 * 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                glm::vec4 position(positions.read(i, 0), positions.read(i, 1), positions.read(i, 2), 1.0f);
+                vertices[i].position = glm::vec3(draw.transform * position);
+                if (normalIndex != nullptr) {
+                    glm::vec3 normal = normalMatrix * glm::vec3(normals.read(i, 0), normals.read(i, 1), normals.read(i, 2));
+                    float length = glm::length(normal);
+                    vertices[i].normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+                }
+                vertices[i].texCoord = texCoordIndex != nullptr ? glm::vec2(texCoords.read(i, 0), texCoords.read(i, 1)) : glm::vec2(0.0f);
+            }
+        }, threadCount);
+
+        if (normalIndex == nullptr) {
+            needsNormal.resize(vertexCount, 0);
+            std::fill(needsNormal.begin() + static_cast<std::ptrdiff_t>(draw.firstVertex),
+                      needsNormal.begin() + static_cast<std::ptrdiff_t>(draw.firstVertex + draw.vertexCount), 1);
+        }
+
+        // Mirroring transforms turn the winding inside out
+        bool flip = glm::determinant(glm::mat3(draw.transform)) < 0.0f;
+        const JsonValue* indicesIndex = draw.primitive->find("indices");
+        GltfAccessor indices;
+        if (indicesIndex != nullptr) { indices = getAccessor(root, static_cast<size_t>(indicesIndex->number), bin, binSize); }
+        uint32_t* out = mesh.indices.data() + draw.firstIndex;
+        uint32_t base = static_cast<uint32_t>(draw.firstVertex);
+        std::atomic<bool> outOfRange{false};
+        parallelFor(static_cast<uint32_t>(draw.indexCount / 3), 16 * 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t triangle = begin; triangle < end; triangle++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    size_t source = triangle * 3ull + (flip && k > 0 ? 3 - k : k);
+                    uint32_t index = indicesIndex != nullptr ? indices.readIndex(source) : static_cast<uint32_t>(source);
+                    if (index >= draw.vertexCount) { outOfRange = true; index = 0; }
+                    out[triangle * 3ull + k] = base + index;
+                }
+            }
+        }, threadCount);
+        if (outOfRange) { throw std::runtime_error("glTF index out of range!"); }
+    }
+
+    if (!needsNormal.empty()) { computeMissingNormals(mesh.vertices, mesh.indices, needsNormal); }
+    return mesh;
+}
@@ -0,0 +1,33 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Mesh.h"
+
+// Loads triangle meshes from Wavefront OBJ and binary glTF 2.0 (.glb) into Mesh::vertices/indices.
+// Files are memory-mapped rather than read. Everything in a file is merged into one mesh: OBJ groups
+// and objects are concatenated, and glTF meshes are placed by the node hierarchy of the default scene.
+// Texture coordinates follow Vulkan's convention (v = 0 at the top of the image), so OBJ's v is flipped.
+// Vertices without normals get area-weighted smooth normals. Errors throw std::runtime_error.
+class MeshLoader {
+public:
+    // Picks the format from the extension (.obj or .glb, case insensitive)
+    static Mesh load(const std::string& path, uint32_t threadCount = 0);
+
+    // OBJ text is split into line-aligned chunks that are parsed on up to threadCount threads
+    // (0 = hardware concurrency). Relative (negative) indices, polygons (fan triangulated) and all
+    // v, v/vt, v//vn and v/vt/vn corner forms are supported. Corners with the same v/vt/vn triple
+    // become one vertex: each chunk deduplicates its corners in a hash table, then the chunks' unique
+    // corners are merged through a hash table split into one shard per thread.
+    static Mesh parseObj(const char* text, size_t size, uint32_t threadCount = 0);
+
+    // GLB container with its embedded BIN buffer. Reads POSITION, NORMAL and TEXCOORD_0 of every
+    // triangle-list primitive; other attributes, materials, external buffers and sparse accessors are
+    // not supported. glTF meshes are already indexed, so vertices are converted as they are.
+    static Mesh parseGlb(const char* data, size_t size, uint32_t threadCount = 0);
+};
+
+#endif // MESH_LOADER_H
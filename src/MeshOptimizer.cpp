@@ -0,0 +1,282 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// Forsyth's scoring constants; the cache size here is the model the algorithm optimizes for, not the
+// size used for reporting
+constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+    // Vertices without triangles left to emit no longer matter
+    if (remainingTriangles == 0) { return -1.0f; }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The three vertices of the last triangle get a fixed score so the next triangle does not simply
+        // reuse the same edge; older entries decay with their position
+        if (cachePosition < 3) { score = LAST_TRIANGLE_SCORE; }
+        else {
+            float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertices with few triangles left, so lone triangles are not left behind
+    score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+    return score;
+}
+
+// FIFO cache replay: an entry is a hit while fewer than size misses happened since it was loaded
+class FifoCache {
+public:
+    FifoCache(size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), size(cacheSize), time(cacheSize + 1) {}
+
+    // Returns 1 on a miss (the vertex is transformed), 0 on a hit
+    uint32_t access(uint32_t vertex) {
+        if (time - timestamps[vertex] > size) {
+            timestamps[vertex] = time++;
+            return 1;
+        }
+        return 0;
+    }
+
+    void reset() { time += size + 1; }
+
+private:
+    std::vector<uint32_t> timestamps;
+    uint32_t size;
+    uint32_t time;
+};
+
+} // namespace
+
+void MeshOptimizer::optimize(Mesh& mesh) {
+    if (mesh.vertexFormat != VertexFormat::Float || mesh.vertexLayout != VertexLayout::Interleaved || !mesh.lods.empty()) {
+        throw std::runtime_error("mesh optimization must run before quantization, stream splitting and LOD generation!");
+    }
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh);
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) { return; }
+
+    // Triangles of each vertex; the first remaining[v] entries of a vertex's range are still to be emitted
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices) { remaining[index]++; }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) { offsets[v + 1] = offsets[v] + remaining[v]; }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (size_t k = 0; k < 3; k++) { adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t); }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) { scores[v] = vertexScore(-1, remaining[v]); }
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+    }
+    std::vector<bool> emitted(triangleCount, false);
+
+    size_t best = static_cast<size_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    size_t fallbackCursor = 0;
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (best == SIZE_MAX) {
+            // Nothing in the cache has triangles left; continue with the next triangle in input order
+            while (emitted[fallbackCursor]) { fallbackCursor++; }
+            best = fallbackCursor;
+        }
+
+        emitted[best] = true;
+        const uint32_t triangle[3] = {indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]};
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // Move the triangle out of each vertex's live range
+        for (uint32_t v : triangle) {
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            uint32_t* found = std::find(begin, end, static_cast<uint32_t>(best));
+            if (found != end) {
+                std::swap(*found, *(end - 1));
+                remaining[v]--;
+            }
+        }
+
+        // The triangle's vertices move to the front; whatever falls off the end is evicted
+        newCache.clear();
+        for (uint32_t v : triangle) {
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) { newCache.push_back(v); }
+        }
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) { newCache.push_back(v); }
+        }
+        for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+            cachePosition[newCache[i]] = -1;
+            scores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        for (size_t i = 0; i < newCache.size() && i < FORSYTH_CACHE_SIZE; i++) {
+            cachePosition[newCache[i]] = static_cast<int>(i);
+            scores[newCache[i]] = vertexScore(static_cast<int>(i), remaining[newCache[i]]);
+        }
+
+        // Rescore the live triangles of every touched vertex; the next triangle comes from the cached ones
+        best = SIZE_MAX;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < newCache.size(); i++) {
+            uint32_t v = newCache[i];
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacency[offsets[v] + j];
+                float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                triangleScores[t] = score;
+                if (i < FORSYTH_CACHE_SIZE && score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if (newCache.size() > FORSYTH_CACHE_SIZE) { newCache.resize(FORSYTH_CACHE_SIZE); }
+        cache.swap(newCache);
+    }
+
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) { return; }
+
+    // Hard boundaries: triangles whose three vertices all miss start over in the cache anyway, so the
+    // order can be broken there for free
+    std::vector<size_t> hardStarts;
+    {
+        FifoCache cache(vertices.size(), SIMULATED_CACHE_SIZE);
+        for (size_t t = 0; t < triangleCount; t++) {
+            uint32_t misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3) { hardStarts.push_back(t); }
+        }
+        hardStarts.push_back(triangleCount);
+    }
+
+    // Soft boundaries: split a hard cluster further once its running miss ratio (from a cold cache)
+    // is within the threshold of the whole cluster's, so reordering costs at most that factor
+    std::vector<size_t> clusterStarts;
+    FifoCache cache(vertices.size(), SIMULATED_CACHE_SIZE);
+    for (size_t h = 0; h + 1 < hardStarts.size(); h++) {
+        size_t start = hardStarts[h];
+        size_t end = hardStarts[h + 1];
+
+        cache.reset();
+        uint32_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            clusterMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+        }
+        float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+        cache.reset();
+        clusterStarts.push_back(start);
+        size_t softStart = start;
+        uint32_t misses = 0;
+        for (size_t t = start; t < end; t++) {
+            misses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            float acmr = static_cast<float>(misses) / static_cast<float>(t - softStart + 1);
+            if (acmr <= clusterThreshold && t + 1 < end) {
+                clusterStarts.push_back(t + 1);
+                softStart = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+
+    // Area-weighted centroid and normal per cluster, and the mesh centroid
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        float clusterArea = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            glm::vec3 centroid = (a + b + d) / 3.0f;
+
+            clusterCentroids[c] += centroid * area;
+            clusterNormals[c] += normal;
+            clusterArea += area;
+            meshCentroid += centroid * area;
+            meshArea += area;
+        }
+        if (clusterArea > 0.0f) { clusterCentroids[c] = clusterCentroids[c] / clusterArea; }
+    }
+    if (meshArea > 0.0f) { meshCentroid = meshCentroid / meshArea; }
+
+    // Clusters facing away from the center are more likely to occlude the rest, so they are drawn first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) { sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]); }
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (size_t c : order) {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(Mesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(mesh.vertices.size());
+
+    for (auto& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(reordered);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats;
+    FifoCache cache(vertexCount, cacheSize);
+    for (uint32_t index : indices) { stats.transformedVertices += cache.access(index); }
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount > 0) { stats.acmr = static_cast<float>(stats.transformedVertices) / static_cast<float>(triangleCount); }
+    if (vertexCount > 0) { stats.atvr = static_cast<float>(stats.transformedVertices) / static_cast<float>(vertexCount); }
+    return stats;
+}
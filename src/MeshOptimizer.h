@@ -0,0 +1,41 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// Result of replaying an index buffer through a simulated FIFO post-transform vertex cache
+struct VertexCacheStats {
+    uint32_t transformedVertices = 0;
+    // Average cache miss ratio: vertex shader invocations per triangle (0.5 is ideal for large grids, 3 is worst)
+    float acmr = 0.0f;
+    // Average transformed vertex ratio: vertex shader invocations per vertex (1.0 is ideal)
+    float atvr = 0.0f;
+};
+
+// Reorders a mesh for the GPU before upload. All functions work on the float, interleaved data
+// (Mesh::vertices/indices), so they must run before Mesh::quantize(), Mesh::splitStreams() and
+// MeshSimplifier::buildLodChain().
+class MeshOptimizer {
+public:
+    // Runs the three passes below in order: vertex cache, overdraw, vertex fetch
+    static void optimize(Mesh& mesh);
+
+    // Reorders triangles for post-transform vertex cache reuse (Forsyth's linear-speed algorithm)
+    static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+    // Reorders clusters of cache-optimized triangles so that outward-facing clusters come first and
+    // occlude the rest (Sander et al.). The cache miss ratio may grow by at most the given factor.
+    static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+    // Reorders vertices by first use so that fetches walk the vertex buffer linearly; unreferenced
+    // vertices are dropped. Rewrites the indices accordingly.
+    static void optimizeVertexFetch(Mesh& mesh);
+
+    static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = SIMULATED_CACHE_SIZE);
+
+    // FIFO size used for reporting; close to what current GPUs effectively reuse
+    static constexpr uint32_t SIMULATED_CACHE_SIZE = 16;
+};
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,251 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Symmetric 4x4 matrix accumulating squared distances to planes (Garland-Heckbert)
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void addPlane(double a, double b, double c, double d) {
+        a00 += a * a; a01 += a * b; a02 += a * c; a03 += a * d;
+        a11 += b * b; a12 += b * c; a13 += b * d;
+        a22 += c * c; a23 += c * d;
+        a33 += d * d;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+    }
+
+    // Sum of squared distances from p to the accumulated planes
+    [[nodiscard]] double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                      + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                      + a22 * z * z + 2 * a23 * z
+                      + a33;
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct PositionEqual {
+    bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+};
+
+glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return glm::cross(b - a, c - a);
+}
+
+// Vertices that must not move: on an open border or sharing their position with another vertex
+std::vector<bool> findLockedVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    std::vector<bool> locked(vertices.size(), false);
+
+    std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> firstAtPosition;
+    firstAtPosition.reserve(vertices.size());
+    for (uint32_t v = 0; v < vertices.size(); v++) {
+        auto inserted = firstAtPosition.emplace(vertices[v].position, v);
+        if (!inserted.second) {
+            locked[v] = true;
+            locked[inserted.first->second] = true;
+        }
+    }
+
+    // An edge seen once in either direction borders a hole or the mesh outline
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    edgeUses.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (size_t k = 0; k < 3; k++) {
+            uint64_t a = indices[i + k];
+            uint64_t b = indices[i + (k + 1) % 3];
+            edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+    for (const auto& edge : edgeUses) {
+        if (edge.second == 1) {
+            locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+            locked[static_cast<uint32_t>(edge.first & 0xffffffffu)] = true;
+        }
+    }
+    return locked;
+}
+
+} // namespace
+
+std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& sourceIndices,
+                                               size_t targetIndexCount, float targetError, float* resultError) {
+    std::vector<uint32_t> indices = sourceIndices;
+    size_t vertexCount = vertices.size();
+    std::vector<bool> locked = findLockedVertices(vertices, indices);
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& a = vertices[indices[i]].position;
+        glm::vec3 normal = triangleNormal(a, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+        float length = glm::length(normal);
+        if (length == 0.0f) { continue; }
+        normal = normal / length;
+        double d = -glm::dot(normal, a);
+        for (size_t k = 0; k < 3; k++) { quadrics[indices[i + k]].addPlane(normal.x, normal.y, normal.z, d); }
+    }
+
+    double maxCost = static_cast<double>(targetError) * targetError;
+    double appliedCost = 0.0;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<Collapse> collapses;
+
+    // Each pass collapses an independent set of the cheapest edges, then rebuilds the index list
+    while (indices.size() > targetIndexCount) {
+        size_t triangleCount = indices.size() / 3;
+
+        // Triangles around each vertex, for the flip test
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32_t index : indices) { triangleOffsets[index + 1]++; }
+        for (size_t v = 0; v < vertexCount; v++) { triangleOffsets[v + 1] += triangleOffsets[v]; }
+        vertexTriangles.resize(indices.size());
+        {
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) { vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3); }
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t a = indices[i + k];
+                uint32_t b = indices[i + (k + 1) % 3];
+                // Interior edges appear once per direction, so each direction is a separate candidate
+                if (locked[a]) { continue; }
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                double cost = q.evaluate(vertices[b].position);
+                if (cost <= maxCost) { collapses.push_back({a, b, cost}); }
+            }
+        }
+        if (collapses.empty()) { break; }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++) { remap[v] = static_cast<uint32_t>(v); }
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t removableTriangles = triangleCount - targetIndexCount / 3;
+        size_t removedTriangles = 0;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removedTriangles >= removableTriangles) { break; }
+            if (touched[collapse.from] || touched[collapse.to]) { continue; }
+
+            // Reject collapses that would flip or degenerate any remaining triangle around 'from'
+            const glm::vec3& target = vertices[collapse.to].position;
+            bool flips = false;
+            size_t collapsedTriangles = 0;
+            for (uint32_t j = triangleOffsets[collapse.from]; j < triangleOffsets[collapse.from + 1] && !flips; j++) {
+                const uint32_t* triangle = &indices[vertexTriangles[j] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    collapsedTriangles++;
+                    continue;
+                }
+                glm::vec3 p[3];
+                for (size_t k = 0; k < 3; k++) { p[k] = vertices[triangle[k]].position; }
+                glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+                for (size_t k = 0; k < 3; k++) { if (triangle[k] == collapse.from) { p[k] = target; } }
+                glm::vec3 after = triangleNormal(p[0], p[1], p[2]);
+                // Also rejects slivers: the new normal must keep a reasonable share of its length
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips) { continue; }
+
+            // Neighbours of both ends are frozen for the rest of the pass, so the tests above stay valid
+            for (uint32_t end : {collapse.from, collapse.to}) {
+                for (uint32_t j = triangleOffsets[end]; j < triangleOffsets[end + 1]; j++) {
+                    const uint32_t* triangle = &indices[vertexTriangles[j] * 3];
+                    for (size_t k = 0; k < 3; k++) { touched[triangle[k]] = true; }
+                }
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            appliedCost = std::max(appliedCost, collapse.cost);
+            removedTriangles += collapsedTriangles;
+            applied++;
+        }
+        if (applied == 0) { break; }
+
+        // Apply the remap and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            uint32_t a = remap[indices[i]];
+            uint32_t b = remap[indices[i + 1]];
+            uint32_t c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c) { continue; }
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    if (resultError != nullptr) { *resultError = static_cast<float>(std::sqrt(appliedCost)); }
+    return indices;
+}
+
+void MeshSimplifier::buildLodChain(Mesh& mesh, const LodSettings& settings) {
+    size_t sourceIndexCount = mesh.indices.size();
+    mesh.lods.clear();
+    mesh.lods.push_back({0, static_cast<uint32_t>(sourceIndexCount), 0.0f});
+    if (mesh.vertices.empty() || sourceIndexCount == 0) { return; }
+
+    float maxError = settings.maxRelativeError * glm::length(mesh.boundsExtent);
+
+    std::vector<uint32_t> previous(mesh.indices.begin(), mesh.indices.end());
+    float previousError = 0.0f;
+    for (float ratio : settings.targetRatios) {
+        size_t target = static_cast<size_t>(static_cast<float>(sourceIndexCount / 3) * ratio) * 3;
+        if (target >= previous.size()) { continue; }
+
+        // Errors of successive levels add up, since each is simplified from the one before
+        float remainingError = maxError - previousError;
+        if (remainingError <= 0.0f) { break; }
+        float levelError = 0.0f;
+        std::vector<uint32_t> lodIndices = simplify(mesh.vertices, previous, target, remainingError, &levelError);
+        if (static_cast<float>(lodIndices.size()) > static_cast<float>(previous.size()) * (1.0f - settings.minReduction)) { break; }
+
+        MeshOptimizer::optimizeVertexCache(lodIndices, mesh.vertices.size());
+        MeshLod lod;
+        lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+        lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+        lod.error = previousError + levelError;
+        mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+        mesh.lods.push_back(lod);
+
+        previous = std::move(lodIndices);
+        previousError = lod.error;
+    }
+}
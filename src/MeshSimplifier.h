@@ -0,0 +1,36 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+struct LodSettings {
+    // Target triangle count of each LOD after the first, as a fraction of the source mesh
+    std::vector<float> targetRatios = {0.5f, 0.25f, 0.125f, 0.0625f};
+    // Largest geometric error allowed for any LOD, relative to the mesh bounding box diagonal
+    float maxRelativeError = 0.05f;
+    // A level that removes less than this fraction of the previous level's triangles ends the chain
+    float minReduction = 0.1f;
+};
+
+// Quadric error metric simplification by half-edge collapse: vertices are only ever merged into
+// other existing vertices, so every LOD indexes the original vertex buffer and only the index
+// buffer grows. Vertices on open borders and attribute seams (several vertices at one position,
+// e.g. the hard edges of a cube) are locked, which keeps silhouettes and UV/normal seams intact.
+class MeshSimplifier {
+public:
+    // Returns a new index list with at most targetIndexCount indices where reachable without exceeding
+    // targetError (object-space distance). resultError receives the error actually introduced.
+    static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                          size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+    // Appends the LOD index lists to mesh.indices and fills mesh.lods (level 0 is the source mesh).
+    // Each level is simplified from the previous one and cache-optimized. Must run after
+    // Mesh::computeBounds(), which scales the error limit, and before the index buffer is created;
+    // vertex format and layout do not matter as Mesh::vertices is kept.
+    static void buildLodChain(Mesh& mesh, const LodSettings& settings = LodSettings{});
+};
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,179 @@
+#include "MeshWelder.h"
+#include "DenseKeyTable.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Vertices per range of the local deduplication pass
+constexpr uint32_t WELD_RANGE_SIZE = 64 * 1024;
+
+struct WeldKey {
+    int32_t values[8];
+
+    bool operator==(const WeldKey& other) const { return std::memcmp(values, other.values, sizeof(values)) == 0; }
+};
+
+int32_t quantize(float value, float step) {
+    if (step <= 0.0f) {
+        // Exact comparison: the bit pattern, with -0 folded into +0
+        if (value == 0.0f) { return 0; }
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    double snapped = std::floor(static_cast<double>(value) / step + 0.5);
+    return static_cast<int32_t>(std::max(-2147483648.0, std::min(2147483647.0, snapped)));
+}
+
+WeldKey makeKey(const Vertex& vertex, const WeldTolerance& tolerance) {
+    WeldKey key;
+    for (int i = 0; i < 3; i++) { key.values[i] = quantize(vertex.position[i], tolerance.position); }
+    for (int i = 0; i < 3; i++) { key.values[3 + i] = quantize(vertex.normal[i], tolerance.normal); }
+    for (int i = 0; i < 2; i++) { key.values[6 + i] = quantize(vertex.texCoord[i], tolerance.texCoord); }
+    return key;
+}
+
+uint64_t hashKey(const WeldKey& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int32_t value : key.values) { hash = hashCombine(hash, static_cast<uint32_t>(value)); }
+    return hash;
+}
+
+struct WeldRange {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    // Slot of every vertex in the range's local table
+    std::vector<uint32_t> vertexSlots;
+    std::vector<WeldKey> uniqueKeys;
+    std::vector<uint64_t> uniqueHashes;
+    // First vertex of each local key, then (after the merge) first vertex of the key in the whole mesh
+    std::vector<uint32_t> owners;
+    // Vertices of the range that survive
+    uint32_t keptCount = 0;
+};
+
+} // namespace
+
+WeldStats MeshWelder::weld(Mesh& mesh, const WeldTolerance& tolerance, uint32_t threadCount) {
+    TRACE_SCOPE("MeshWelder::weld");
+    if (mesh.vertices.size() > UINT32_MAX) { throw std::runtime_error("mesh has too many vertices to weld!"); }
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+
+    WeldStats stats;
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    stats.verticesBefore = vertexCount;
+
+    uint32_t rangeCount = (vertexCount + WELD_RANGE_SIZE - 1) / WELD_RANGE_SIZE;
+    std::vector<WeldRange> ranges(rangeCount);
+    for (uint32_t r = 0; r < rangeCount; r++) {
+        ranges[r].begin = r * WELD_RANGE_SIZE;
+        ranges[r].end = std::min(vertexCount, ranges[r].begin + WELD_RANGE_SIZE);
+    }
+    auto forEachRange = [&](const std::function<void(WeldRange&, uint32_t)>& body) {
+        parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t r = begin; r < end; r++) { body(ranges[r], r); }
+        }, threadCount);
+    };
+
+    {
+        TRACE_SCOPE("hash ranges");
+        forEachRange([&](WeldRange& range, uint32_t) {
+            DenseKeyTable<WeldKey> table(range.end - range.begin);
+            range.vertexSlots.resize(range.end - range.begin);
+            for (uint32_t v = range.begin; v < range.end; v++) {
+                WeldKey key = makeKey(mesh.vertices[v], tolerance);
+                bool inserted = false;
+                uint32_t slot = table.findOrInsert(key, hashKey(key), inserted);
+                if (inserted) { range.owners.push_back(v); }
+                range.vertexSlots[v - range.begin] = slot;
+            }
+            range.uniqueKeys = std::move(table.keys);
+            range.uniqueHashes = std::move(table.hashes);
+        });
+    }
+
+    // Only needed when a key can repeat across ranges; the shards walk the ranges in vertex order, so
+    // the first range holding a key owns it
+    if (rangeCount > 1) {
+        TRACE_SCOPE("merge shards");
+        size_t uniqueTotal = 0;
+        for (const WeldRange& range : ranges) { uniqueTotal += range.uniqueKeys.size(); }
+        uint32_t shardCount = threadCount;
+        parallelFor(shardCount, 1, [&](uint32_t shardBegin, uint32_t shardEnd) {
+            for (uint32_t shard = shardBegin; shard < shardEnd; shard++) {
+                DenseKeyTable<WeldKey> table(uniqueTotal / shardCount);
+                std::vector<uint32_t> tableOwners;
+                for (WeldRange& range : ranges) {
+                    for (size_t slot = 0; slot < range.uniqueKeys.size(); slot++) {
+                        // The table indexes with the low hash bits, so shards are picked with the high ones
+                        if ((range.uniqueHashes[slot] >> 40) % shardCount != shard) { continue; }
+                        bool inserted = false;
+                        uint32_t entry = table.findOrInsert(range.uniqueKeys[slot], range.uniqueHashes[slot], inserted);
+                        if (inserted) { tableOwners.push_back(range.owners[slot]); }
+                        range.owners[slot] = tableOwners[entry];
+                    }
+                }
+            }
+        }, threadCount);
+    }
+
+    // Survivors keep their relative order; number them range by range
+    std::vector<uint32_t> remap(vertexCount);
+    forEachRange([&](WeldRange& range, uint32_t) {
+        for (uint32_t v = range.begin; v < range.end; v++) {
+            remap[v] = range.owners[range.vertexSlots[v - range.begin]];
+            if (remap[v] == v) { range.keptCount++; }
+        }
+    });
+    std::vector<uint32_t> rangeBases(rangeCount);
+    uint32_t keptTotal = 0;
+    for (uint32_t r = 0; r < rangeCount; r++) {
+        rangeBases[r] = keptTotal;
+        keptTotal += ranges[r].keptCount;
+    }
+    stats.verticesAfter = keptTotal;
+    if (keptTotal == vertexCount) { return stats; }
+
+    std::vector<Vertex> welded(keptTotal);
+    std::vector<uint32_t> newIds(vertexCount);
+    forEachRange([&](WeldRange& range, uint32_t r) {
+        uint32_t next = rangeBases[r];
+        for (uint32_t v = range.begin; v < range.end; v++) {
+            if (remap[v] != v) { continue; }
+            welded[next] = mesh.vertices[v];
+            newIds[v] = next++;
+        }
+    });
+    mesh.vertices = std::move(welded);
+
+    // Owners precede the vertices they absorb, so their new ids are all known by now
+    uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    std::vector<uint8_t> degenerate(triangleCount, 0);
+    parallelFor(triangleCount, WELD_RANGE_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            uint32_t* corner = &mesh.indices[t * 3];
+            for (int k = 0; k < 3; k++) { corner[k] = newIds[remap[corner[k]]]; }
+            degenerate[t] = corner[0] == corner[1] || corner[1] == corner[2] || corner[0] == corner[2];
+        }
+    }, threadCount);
+
+    size_t out = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (degenerate[t]) {
+            stats.degenerateTriangles++;
+            continue;
+        }
+        if (out != t * 3u) { std::copy_n(&mesh.indices[t * 3], 3, &mesh.indices[out]); }
+        out += 3;
+    }
+    mesh.indices.resize(out);
+    return stats;
+}
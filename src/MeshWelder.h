@@ -0,0 +1,43 @@
+#ifndef MESH_WELDER_H
+#define MESH_WELDER_H
+
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Largest difference per component for two vertices to be merged. Each attribute is snapped to a grid of
+// this step before comparison; 0 merges bit-identical values only.
+struct WeldTolerance {
+    float position = 1e-5f;
+    float normal = 1e-3f;
+    float texCoord = 1e-5f;
+};
+
+struct WeldStats {
+    uint32_t verticesBefore = 0;
+    uint32_t verticesAfter = 0;
+    // Triangles that collapsed to a line or point because their corners merged; they are removed
+    uint32_t degenerateTriangles = 0;
+
+    // Vertex buffer size before / after (1 when nothing was merged)
+    [[nodiscard]] float compressionRatio() const {
+        return verticesAfter > 0 ? static_cast<float>(verticesBefore) / static_cast<float>(verticesAfter) : 1.0f;
+    }
+};
+
+// Merges duplicate and near-duplicate vertices: every vertex is quantized by the tolerance and hashed,
+// vertices with equal keys share the first one of them, and the indices are remapped. Vertices that
+// differ in normal or UV beyond the tolerance stay separate, so hard edges and UV seams (like the cube's
+// per-face corners) survive. Near-equal values on opposite sides of a grid line are not merged.
+//
+// Large meshes are processed in parallel: vertex ranges deduplicate their keys locally, then one shard
+// per thread merges the keys whose hash selects it, walking the ranges in order. The surviving vertex of
+// a group is always its first one, so the result does not depend on the thread count.
+class MeshWelder {
+public:
+    // Works on the float, interleaved data; run it before MeshOptimizer and MeshSimplifier.
+    // Unreferenced vertices are kept (MeshOptimizer::optimizeVertexFetch() drops them).
+    static WeldStats weld(Mesh& mesh, const WeldTolerance& tolerance = WeldTolerance{}, uint32_t threadCount = 0);
+};
+
+#endif // MESH_WELDER_H
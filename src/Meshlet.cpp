@@ -0,0 +1,150 @@
+#include "Meshlet.h"
+#include "Frustum.h"
+#include "Mesh.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+void computeMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    uint32_t end = meshlet.firstIndex + meshlet.triangleCount * 3;
+
+    glm::vec3 minCorner(std::numeric_limits<float>::max());
+    glm::vec3 maxCorner(-std::numeric_limits<float>::max());
+    for (uint32_t i = meshlet.firstIndex; i < end; i++) {
+        minCorner = glm::min(minCorner, vertices[indices[i]].position);
+        maxCorner = glm::max(maxCorner, vertices[indices[i]].position);
+    }
+    meshlet.center = (minCorner + maxCorner) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = meshlet.firstIndex; i < end; i++) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+    }
+
+    // Cone around the average face normal, wide enough to contain every face normal
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = meshlet.firstIndex; i < end; i += 3) {
+        const glm::vec3& p0 = vertices[indices[i]].position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+        float length = glm::length(normal);
+        // Degenerate triangles are never rasterized and do not constrain the cone
+        if (length <= 0.0f) { continue; }
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 1e-6f) { return; }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& normal : normals) { minDot = std::min(minDot, glm::dot(normal, axis)); }
+    meshlet.coneAxis = axis;
+    // A cone wider than a hemisphere has faces pointing every way; cutoff 1 keeps it from being culled
+    if (minDot > 0.0f) { meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot); }
+}
+
+} // namespace
+
+std::vector<Meshlet> MeshletBuilder::build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                           uint32_t firstIndex, uint32_t indexCount) {
+    TRACE_SCOPE("MeshletBuilder::build");
+    std::vector<Meshlet> meshlets;
+
+    // Vertices already referenced by the open meshlet, marked with its number + 1
+    std::vector<uint32_t> owner(vertices.size(), 0);
+    Meshlet current;
+    current.firstIndex = firstIndex;
+    uint32_t end = firstIndex + indexCount;
+
+    for (uint32_t i = firstIndex; i + 2 < end; i += 3) {
+        uint32_t stamp = static_cast<uint32_t>(meshlets.size()) + 1;
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t index = indices[i + k];
+            bool repeated = (k > 0 && index == indices[i]) || (k > 1 && index == indices[i + 1]);
+            if (owner[index] != stamp && !repeated) { newVertices++; }
+        }
+
+        if (current.triangleCount == MAX_TRIANGLES || current.vertexCount + newVertices > MAX_VERTICES) {
+            computeMeshletBounds(current, vertices, indices);
+            meshlets.push_back(current);
+            current = Meshlet{};
+            current.firstIndex = i;
+            stamp++;
+            newVertices = 3 - (indices[i + 1] == indices[i]) - (indices[i + 2] == indices[i] || indices[i + 2] == indices[i + 1]);
+        }
+
+        for (uint32_t k = 0; k < 3; k++) { owner[indices[i + k]] = stamp; }
+        current.vertexCount += newVertices;
+        current.triangleCount++;
+    }
+
+    if (current.triangleCount > 0) {
+        computeMeshletBounds(current, vertices, indices);
+        meshlets.push_back(current);
+    }
+    return meshlets;
+}
+
+void MeshletBuilder::buildForMesh(Mesh& mesh) {
+    mesh.meshlets.clear();
+    if (mesh.lods.empty()) {
+        mesh.meshlets = build(mesh.vertices, mesh.indices, 0, static_cast<uint32_t>(mesh.indices.size()));
+        return;
+    }
+
+    for (MeshLod& lod : mesh.lods) {
+        std::vector<Meshlet> lodMeshlets = build(mesh.vertices, mesh.indices, lod.firstIndex, lod.indexCount);
+        lod.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+        lod.meshletCount = static_cast<uint32_t>(lodMeshlets.size());
+        mesh.meshlets.insert(mesh.meshlets.end(), lodMeshlets.begin(), lodMeshlets.end());
+    }
+}
+
+MeshletCullStats MeshletBuilder::cull(const Meshlet* meshlets, uint32_t meshletCount, const glm::mat4& model,
+                                      const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+                                      VkDrawIndexedIndirectCommand* commands) {
+    TRACE_SCOPE("MeshletBuilder::cull");
+
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    glm::mat3 rotation(model);
+    float scale = std::max(glm::length(rotation[0]), std::max(glm::length(rotation[1]), glm::length(rotation[2])));
+
+    MeshletCullStats stats;
+    for (uint32_t m = 0; m < meshletCount; m++) {
+        const Meshlet& meshlet = meshlets[m];
+        glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+        float radius = meshlet.radius * scale;
+
+        bool visible = frustum.intersectsSphere(center, radius);
+        if (!visible) { stats.frustumCulled++; }
+
+        if (visible && meshlet.coneCutoff < 1.0f) {
+            glm::vec3 axis = glm::normalize(rotation * meshlet.coneAxis);
+            glm::vec3 toCenter = center - cameraPosition;
+            if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius) {
+                visible = false;
+                stats.backfaceCulled++;
+            }
+        }
+
+        if (visible) { stats.visible++; }
+
+        VkDrawIndexedIndirectCommand& command = commands[m];
+        command.indexCount = meshlet.triangleCount * 3;
+        command.instanceCount = visible ? 1 : 0;
+        command.firstIndex = meshlet.firstIndex;
+        command.vertexOffset = 0;
+        command.firstInstance = 0;
+    }
+    return stats;
+}
@@ -0,0 +1,68 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Mesh;
+struct Vertex;
+
+// A cluster of at most MeshletBuilder::MAX_VERTICES vertices and MAX_TRIANGLES triangles. Without mesh
+// shaders a meshlet is drawn as a contiguous range of the mesh's index buffer.
+struct Meshlet {
+    uint32_t firstIndex = 0;
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;
+
+    // Object-space bounding sphere
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // Normal cone: every triangle faces away from a viewer for which
+    // dot(center - viewer, coneAxis) >= coneCutoff * |center - viewer| + radius (coneCutoff = 1 disables it)
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 1.0f;
+};
+
+struct MeshletCullStats {
+    uint64_t visible = 0;
+    uint64_t frustumCulled = 0;
+    uint64_t backfaceCulled = 0;
+
+    MeshletCullStats& operator+=(const MeshletCullStats& other) {
+        visible += other.visible;
+        frustumCulled += other.frustumCulled;
+        backfaceCulled += other.backfaceCulled;
+        return *this;
+    }
+};
+
+class MeshletBuilder {
+public:
+    // 64/124 keeps a meshlet's vertices and primitive indices within what mesh shader hardware handles
+    // in one workgroup, so the same clusters carry over to a mesh shading path
+    static constexpr uint32_t MAX_VERTICES = 64;
+    static constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // Splits [firstIndex, firstIndex + indexCount) of the index buffer into meshlets in index order.
+    // Run it on cache-optimized indices: consecutive triangles then share vertices and the clusters
+    // come out compact.
+    static std::vector<Meshlet> build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                      uint32_t firstIndex, uint32_t indexCount);
+
+    // Builds meshlets for every level of detail (or the whole index buffer without LODs) into
+    // mesh.meshlets and records each level's meshlet range
+    static void buildForMesh(Mesh& mesh);
+
+    // Writes one indirect draw per meshlet; culled meshlets get instanceCount 0 so the command count
+    // recorded in the command buffer never changes. model may rotate, translate and scale uniformly.
+    static MeshletCullStats cull(const Meshlet* meshlets, uint32_t meshletCount, const glm::mat4& model,
+                                 const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+                                 VkDrawIndexedIndirectCommand* commands);
+};
+
+#endif // MESHLET_H
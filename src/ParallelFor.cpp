@@ -0,0 +1,55 @@
+#include "ParallelFor.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void parallelFor(uint32_t count, uint32_t minRange, const std::function<void(uint32_t begin, uint32_t end)>& body,
+                 uint32_t threadCount) {
+    if (count == 0) { return; }
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+    uint32_t rangeCount = std::min(threadCount, std::max(1u, count / std::max(1u, minRange)));
+    if (rangeCount == 1) {
+        body(0, count);
+        return;
+    }
+
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+    auto runRange = [&](uint32_t range) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * range / rangeCount);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (range + 1) / rangeCount);
+        try {
+            body(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(failureMutex);
+            if (!failure) { failure = std::current_exception(); }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(rangeCount - 1);
+    for (uint32_t range = 1; range < rangeCount; range++) { threads.emplace_back(runRange, range); }
+    runRange(0);
+    for (auto& thread : threads) { thread.join(); }
+
+    if (failure) { std::rethrow_exception(failure); }
+}
+
+void parallelFor(const ParallelTarget& target, uint32_t count, uint32_t minRange,
+                 const std::function<void(uint32_t begin, uint32_t end)>& body) {
+    if (target.workers == nullptr) {
+        parallelFor(count, minRange, body, target.threadCount);
+        return;
+    }
+    if (count == 0) { return; }
+    uint32_t rangeCount = std::min(target.workers->getWorkerCount(), std::max(1u, count / std::max(1u, minRange)));
+    target.workers->run(rangeCount, [&](uint32_t range) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * range / rangeCount);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (range + 1) / rangeCount);
+        body(begin, end);
+    });
+}
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <cstdint>
+#include <functional>
+
+// Splits [0, count) into one contiguous range per thread and runs body(begin, end) on each. Ranges hold
+// at least minRange items, so small inputs stay on fewer threads (or only the caller). threadCount 0
+// means hardware concurrency. The calling thread takes a range as well; the first exception thrown by
+// body is rethrown once every range has finished.
+void parallelFor(uint32_t count, uint32_t minRange, const std::function<void(uint32_t begin, uint32_t end)>& body,
+                 uint32_t threadCount = 0);
+
+class WorkerPool;
+
+// Where a parallelFor runs: on the persistent threads of workers when set (for per-frame work, which
+// should not create threads), otherwise on threadCount fresh threads as above
+struct ParallelTarget {
+    WorkerPool* workers = nullptr;
+    uint32_t threadCount = 0;
+};
+
+// Same split as above, so results do not depend on the target; with a pool, one range per worker
+void parallelFor(const ParallelTarget& target, uint32_t count, uint32_t minRange,
+                 const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+#endif // PARALLEL_FOR_H
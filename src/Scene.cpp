@@ -0,0 +1,131 @@
+#include "Scene.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+SceneNode Scene::addNode(SceneNode parent, const glm::mat4& local, bool normalMatrix) {
+    uint32_t parentSlot = NO_PARENT;
+    uint32_t depth = 0;
+    if (parent != NO_PARENT) {
+        if (parent >= nodeSlots.size()) { throw std::runtime_error("scene node parent does not exist!"); }
+        parentSlot = nodeSlots[parent];
+        depth = depths[parentSlot] + 1;
+    }
+    if (!depths.empty() && depth < depths.back()) { layoutDirty = true; }
+
+    SceneNode node = static_cast<SceneNode>(nodeSlots.size());
+    nodeSlots.push_back(static_cast<uint32_t>(slotNodes.size()));
+    slotNodes.push_back(node);
+    localMatrices.push_back(local);
+    worldMatrices.push_back(local);
+    normalMatrices.emplace_back(1.0f);
+    parentSlots.push_back(parentSlot);
+    depths.push_back(depth);
+    flags.push_back(static_cast<uint8_t>(LOCAL_DIRTY | (normalMatrix ? WANTS_NORMAL_MATRIX : 0)));
+
+    // Appending in depth order keeps the layout sorted, and only the last level grows
+    if (!layoutDirty) {
+        if (depth + 1 >= levelStarts.size()) { levelStarts.resize(depth + 2, levelStarts.empty() ? 0 : levelStarts.back()); }
+        levelStarts[depth + 1] = static_cast<uint32_t>(slotNodes.size());
+    }
+    return node;
+}
+
+void Scene::clear() {
+    localMatrices.clear();
+    worldMatrices.clear();
+    normalMatrices.clear();
+    parentSlots.clear();
+    depths.clear();
+    flags.clear();
+    slotNodes.clear();
+    nodeSlots.clear();
+    levelStarts.clear();
+    layoutDirty = false;
+}
+
+void Scene::setLocal(SceneNode node, const glm::mat4& local) {
+    uint32_t slot = nodeSlots[node];
+    localMatrices[slot] = local;
+    flags[slot] |= LOCAL_DIRTY;
+}
+
+void Scene::sortByDepth() {
+    TRACE_SCOPE("Scene::sortByDepth");
+    uint32_t count = static_cast<uint32_t>(slotNodes.size());
+    uint32_t maxDepth = *std::max_element(depths.begin(), depths.end());
+
+    // Counting sort: stable, so siblings keep the order they were added in
+    levelStarts.assign(maxDepth + 2, 0);
+    for (uint32_t depth : depths) { levelStarts[depth + 1]++; }
+    for (uint32_t level = 1; level < levelStarts.size(); level++) { levelStarts[level] += levelStarts[level - 1]; }
+    std::vector<uint32_t> newSlots(count);
+    std::vector<uint32_t> cursors(levelStarts.begin(), levelStarts.end() - 1);
+    for (uint32_t slot = 0; slot < count; slot++) { newSlots[slot] = cursors[depths[slot]]++; }
+
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(values.size());
+        for (uint32_t slot = 0; slot < count; slot++) { sorted[newSlots[slot]] = values[slot]; }
+        values.swap(sorted);
+    };
+    permute(localMatrices);
+    permute(worldMatrices);
+    permute(normalMatrices);
+    permute(depths);
+    permute(flags);
+    permute(slotNodes);
+    permute(parentSlots);
+    for (uint32_t& parent : parentSlots) {
+        if (parent != NO_PARENT) { parent = newSlots[parent]; }
+    }
+    for (uint32_t slot = 0; slot < count; slot++) { nodeSlots[slotNodes[slot]] = slot; }
+    layoutDirty = false;
+}
+
+uint32_t Scene::update(uint32_t threadCount) {
+    return update(ParallelTarget{nullptr, threadCount});
+}
+
+uint32_t Scene::update(WorkerPool& workers) {
+    return update(ParallelTarget{&workers, 0});
+}
+
+uint32_t Scene::update(const ParallelTarget& target) {
+    TRACE_SCOPE("Scene::update");
+    if (layoutDirty) { sortByDepth(); }
+
+    std::atomic<uint32_t> changedCount{0};
+    for (uint32_t level = 0; level + 1 < levelStarts.size(); level++) {
+        uint32_t levelStart = levelStarts[level];
+        parallelFor(target, levelStarts[level + 1] - levelStart, MIN_NODES_PER_THREAD, [&](uint32_t begin, uint32_t end) {
+            uint32_t changed = 0;
+            for (uint32_t slot = levelStart + begin; slot < levelStart + end; slot++) {
+                uint32_t parent = parentSlots[slot];
+                bool parentChanged = parent != NO_PARENT && (flags[parent] & WORLD_CHANGED);
+                if ((flags[slot] & LOCAL_DIRTY) || parentChanged) {
+                    worldMatrices[slot] = parent != NO_PARENT ? worldMatrices[parent] * localMatrices[slot] : localMatrices[slot];
+                    flags[slot] = static_cast<uint8_t>((flags[slot] & ~LOCAL_DIRTY) | WORLD_CHANGED);
+                    changed++;
+                } else {
+                    flags[slot] &= static_cast<uint8_t>(~WORLD_CHANGED);
+                }
+            }
+            changedCount += changed;
+        });
+    }
+
+    // All levels at once: normal matrices only depend on the node's own world matrix
+    uint32_t count = static_cast<uint32_t>(slotNodes.size());
+    parallelFor(target, count, MIN_NODES_PER_THREAD, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t slot = begin; slot < end; slot++) {
+            if ((flags[slot] & (WORLD_CHANGED | WANTS_NORMAL_MATRIX)) == (WORLD_CHANGED | WANTS_NORMAL_MATRIX)) {
+                normalMatrices[slot] = glm::transpose(glm::inverse(glm::mat3(worldMatrices[slot])));
+            }
+        }
+    });
+
+    return changedCount;
+}
@@ -0,0 +1,73 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ParallelFor.h"
+
+// Stable handle of a scene node; nodes keep their handle when the scene reorders its storage
+using SceneNode = uint32_t;
+
+// Transform hierarchy stored as structure-of-arrays and sorted by depth: roots first, then their
+// children, and so on. update() walks one depth level at a time, so every parent's world matrix is final
+// before its children read it, and the nodes of a level are independent and split across threads. A
+// node's world matrix is recomputed only when its local matrix was set or its parent's world matrix
+// changed in the same update; normal matrices follow in one batch over the changed nodes that want them.
+class Scene {
+public:
+    static constexpr SceneNode NO_PARENT = UINT32_MAX;
+
+    // parent must already exist. normalMatrix = false skips the normal matrix of nodes whose consumers
+    // derive it themselves (e.g. instances limited to uniform scale).
+    SceneNode addNode(SceneNode parent, const glm::mat4& local, bool normalMatrix = true);
+    void clear();
+
+    // Safe to call from several threads at once for different nodes
+    void setLocal(SceneNode node, const glm::mat4& local);
+
+    // Propagates dirty local matrices to world and normal matrices. Returns the number of world matrices
+    // that changed. threadCount 0 means hardware concurrency.
+    uint32_t update(uint32_t threadCount = 0);
+    // Same, on persistent workers for scenes updated every frame
+    uint32_t update(WorkerPool& workers);
+
+    // Valid after update()
+    [[nodiscard]] const glm::mat4& getWorld(SceneNode node) const { return worldMatrices[nodeSlots[node]]; }
+    [[nodiscard]] const glm::mat3& getNormalMatrix(SceneNode node) const { return normalMatrices[nodeSlots[node]]; }
+    [[nodiscard]] uint32_t getNodeCount() const { return static_cast<uint32_t>(nodeSlots.size()); }
+    [[nodiscard]] uint32_t getDepthCount() const { return levelStarts.empty() ? 0 : static_cast<uint32_t>(levelStarts.size() - 1); }
+
+private:
+    enum : uint8_t {
+        LOCAL_DIRTY = 1,
+        // Set by update() for nodes whose world matrix it recomputed
+        WORLD_CHANGED = 2,
+        WANTS_NORMAL_MATRIX = 4,
+    };
+
+    // Nodes handed to one thread at a time; smaller levels are updated on the calling thread
+    static constexpr uint32_t MIN_NODES_PER_THREAD = 4096;
+
+    // Per slot, in depth order
+    std::vector<glm::mat4> localMatrices;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<glm::mat3> normalMatrices;
+    std::vector<uint32_t> parentSlots;
+    std::vector<uint32_t> depths;
+    std::vector<uint8_t> flags;
+    std::vector<SceneNode> slotNodes;
+
+    // Slot of each node handle
+    std::vector<uint32_t> nodeSlots;
+    // First slot of each depth level, plus the end
+    std::vector<uint32_t> levelStarts;
+    // Nodes were added out of depth order since the last update()
+    bool layoutDirty = false;
+
+    void sortByDepth();
+    uint32_t update(const ParallelTarget& target);
+};
+
+#endif // SCENE_H
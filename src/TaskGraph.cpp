@@ -0,0 +1,147 @@
+#include "TaskGraph.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependencies) {
+    TaskId id = tasks.size();
+    for (TaskId dependency : dependencies) {
+        if (dependency >= id) { throw std::runtime_error("task dependency must be added before its dependent: " + name); }
+        tasks[dependency].dependents.push_back(id);
+    }
+
+    Task task;
+    task.name = name;
+    task.function = std::move(function);
+    task.dependencies = dependencies;
+    tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::run(uint32_t threadCount) {
+    auto start = Clock::now();
+    usedThreads = std::max<uint32_t>(1, std::min<uint32_t>(threadCount, static_cast<uint32_t>(tasks.size())));
+
+    if (usedThreads == 1) {
+        for (auto& task : tasks) {
+            task.startMs = millisecondsSince(start);
+            task.function();
+            task.durationMs = millisecondsSince(start) - task.startMs;
+            task.thread = 0;
+        }
+        totalWallMs = millisecondsSince(start);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<TaskId> ready;
+    std::vector<size_t> remaining(tasks.size());
+    size_t finished = 0;
+    std::exception_ptr failure;
+
+    for (TaskId id = 0; id < tasks.size(); id++) {
+        remaining[id] = tasks[id].dependencies.size();
+        if (remaining[id] == 0) { ready.push_back(id); }
+    }
+
+    auto worker = [&](uint32_t thread) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [&]() { return !ready.empty() || failure || finished == tasks.size(); });
+            if (failure || finished == tasks.size()) { return; }
+
+            TaskId id = ready.front();
+            ready.pop_front();
+            Task& task = tasks[id];
+
+            lock.unlock();
+            task.startMs = millisecondsSince(start);
+            task.thread = thread;
+            std::exception_ptr error;
+            try {
+                task.function();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            task.durationMs = millisecondsSince(start) - task.startMs;
+            lock.lock();
+
+            finished++;
+            if (error && !failure) { failure = error; }
+            for (TaskId dependent : task.dependents) {
+                if (--remaining[dependent] == 0) { ready.push_back(dependent); }
+            }
+            wakeup.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(usedThreads - 1);
+    for (uint32_t i = 1; i < usedThreads; i++) {
+        threads.emplace_back([&, i]() {
+            Trace::setThreadName("init worker " + std::to_string(i));
+            worker(i);
+        });
+    }
+    worker(0);
+    for (auto& thread : threads) { thread.join(); }
+
+    totalWallMs = millisecondsSince(start);
+    if (failure) { std::rethrow_exception(failure); }
+}
+
+void TaskGraph::printReport(std::ostream& out) const {
+    // Longest chain of dependent tasks: no amount of parallelism gets below its length
+    std::vector<double> chainMs(tasks.size(), 0.0);
+    std::vector<TaskId> chainPrevious(tasks.size(), tasks.size());
+    TaskId chainEnd = 0;
+    double taskSumMs = 0.0;
+    for (TaskId id = 0; id < tasks.size(); id++) {
+        for (TaskId dependency : tasks[id].dependencies) {
+            if (chainMs[dependency] > chainMs[id]) {
+                chainMs[id] = chainMs[dependency];
+                chainPrevious[id] = dependency;
+            }
+        }
+        chainMs[id] += tasks[id].durationMs;
+        taskSumMs += tasks[id].durationMs;
+        if (chainMs[id] > chainMs[chainEnd]) { chainEnd = id; }
+    }
+
+    std::vector<bool> onCriticalPath(tasks.size(), false);
+    for (TaskId id = chainEnd; id < tasks.size(); id = chainPrevious[id]) { onCriticalPath[id] = true; }
+
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+    out << "Startup breakdown (" << usedThreads << (usedThreads == 1 ? " thread" : " threads") << ", * = critical path):\n";
+    out << "  " << std::left << std::setw(28) << "stage" << std::right << std::setw(10) << "start ms" << std::setw(10) << "ms" << std::setw(8) << "thread" << "\n";
+    for (TaskId id = 0; id < tasks.size(); id++) {
+        const Task& task = tasks[id];
+        out << (onCriticalPath[id] ? "* " : "  ") << std::left << std::setw(28) << task.name << std::right
+            << std::setw(10) << task.startMs << std::setw(10) << task.durationMs << std::setw(8) << task.thread << "\n";
+    }
+    out << "  wall " << totalWallMs << " ms, sum of stages " << taskSumMs << " ms, critical path "
+        << (tasks.empty() ? 0.0 : chainMs[chainEnd]) << " ms\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,44 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Run-once dependency graph used to overlap independent initialization steps on worker threads.
+// Tasks may only depend on tasks added before them, so the graph is acyclic by construction and
+// insertion order is a valid serial order. Each task is timed, and printReport() shows the
+// per-stage breakdown together with the critical path that bounds the parallel wall time.
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    TaskId add(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependencies = {});
+
+    // Runs every task once. The calling thread works as well, so threadCount <= 1 runs all tasks
+    // serially in insertion order. The first exception thrown by a task stops scheduling and is
+    // rethrown here once all running tasks have finished.
+    void run(uint32_t threadCount);
+
+    [[nodiscard]] double wallMs() const { return totalWallMs; }
+    void printReport(std::ostream& out) const;
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> function;
+        std::vector<TaskId> dependencies;
+        std::vector<TaskId> dependents;
+        double startMs = 0.0;
+        double durationMs = 0.0;
+        uint32_t thread = 0;
+    };
+
+    std::vector<Task> tasks;
+    uint32_t usedThreads = 0;
+    double totalWallMs = 0.0;
+};
+
+#endif // TASK_GRAPH_H
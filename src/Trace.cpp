@@ -0,0 +1,116 @@
+#include "Trace.h"
+#include "Json.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Trace {
+
+std::atomic<bool> enabledFlag{false};
+
+namespace {
+
+constexpr size_t RING_CAPACITY = 1 << 16; // Events kept per thread
+
+struct ThreadBuffer {
+    uint32_t threadId = 0;
+    std::string threadName;
+    std::array<Event, RING_CAPACITY> events{};
+    // Total events ever written; only the owning thread stores, readers load with acquire
+    std::atomic<uint64_t> writeCount{0};
+};
+
+// Registry of all thread buffers. Buffers outlive their threads so late dumps still see their events.
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        created->threadId = static_cast<uint32_t>(registry.size() + 1);
+        created->threadName = "thread " + std::to_string(created->threadId);
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+} // namespace
+
+void setEnabled(bool enabled) {
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer& buffer = threadBuffer();
+    uint64_t index = buffer.writeCount.load(std::memory_order_relaxed);
+    buffer.events[index % RING_CAPACITY] = Event{name, startNs, endNs - startNs};
+    buffer.writeCount.store(index + 1, std::memory_order_release);
+}
+
+void setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.threadName = name;
+}
+
+void writeChromeTrace(const std::string& filename) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    std::ofstream out(filename);
+    if (!out.is_open()) { throw std::runtime_error("failed to open trace output: " + filename); }
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << std::fixed << std::setprecision(3);
+
+    bool first = true;
+    size_t eventCount = 0;
+    std::vector<Event> snapshot;
+
+    for (const auto& buffer : buffers) {
+        std::string threadName;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            threadName = buffer->threadName;
+        }
+
+        out << (first ? "" : ",\n")
+            << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadId
+            << ", \"args\": {\"name\": \"" << escapeJson(threadName) << "\"}}";
+        first = false;
+
+        // Copy the live window of the ring, then drop anything the writer may have overwritten meanwhile
+        uint64_t end = buffer->writeCount.load(std::memory_order_acquire);
+        uint64_t begin = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+        snapshot.clear();
+        for (uint64_t i = begin; i < end; i++) { snapshot.push_back(buffer->events[i % RING_CAPACITY]); }
+
+        uint64_t endAfterCopy = buffer->writeCount.load(std::memory_order_acquire);
+        uint64_t overwritten = endAfterCopy > RING_CAPACITY ? endAfterCopy - RING_CAPACITY : 0;
+        size_t skip = static_cast<size_t>(overwritten > begin ? std::min<uint64_t>(overwritten - begin, snapshot.size()) : 0);
+
+        for (size_t i = skip; i < snapshot.size(); i++) {
+            const Event& event = snapshot[i];
+            out << ",\n{\"name\": \"" << escapeJson(event.name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadId
+                << ", \"ts\": " << static_cast<double>(event.startNs) / 1000.0
+                << ", \"dur\": " << static_cast<double>(event.durationNs) / 1000.0 << "}";
+            eventCount++;
+        }
+    }
+
+    out << "\n]}\n";
+    std::cout << "Wrote " << eventCount << " trace events to " << filename << std::endl;
+}
+
+} // namespace Trace
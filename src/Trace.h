@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// CPU instrumentation zones recorded into per-thread ring buffers and exported as Chrome trace JSON
+// (viewable in chrome://tracing or ui.perfetto.dev).
+//
+// Zones are compiled in only when ENABLE_TRACING is defined; otherwise TRACE_SCOPE expands to nothing.
+// When compiled in, recording is still off until Trace::setEnabled(true), which reduces a zone to one
+// relaxed atomic load. Zone names must be string literals (only the pointer is stored).
+
+namespace Trace {
+
+struct Event {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+extern std::atomic<bool> enabledFlag;
+
+inline bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+void setEnabled(bool enabled);
+
+inline uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Appends to the calling thread's ring buffer (single writer, no locks after the first call per thread)
+void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+void setThreadName(const std::string& name);
+
+// Writes the events currently held in all ring buffers; safe to call while other threads keep recording
+void writeChromeTrace(const std::string& filename);
+
+class Scope {
+public:
+    explicit Scope(const char* zoneName) : name(zoneName), startNs(isEnabled() ? nowNs() : 0) {}
+    ~Scope() { if (startNs != 0) { record(name, startNs, nowNs()); } }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+} // namespace Trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_TRACING
+    #define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+    #define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,36 @@
+#include "UniformRing.h"
+
+#include <stdexcept>
+
+void UniformRing::init(DeviceAllocator& allocator, VkPhysicalDevice physicalDevice, VkDeviceSize requestedRegionSize, uint32_t count) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+    regionSize = (requestedRegionSize + alignment - 1) / alignment * alignment;
+    regionCount = count;
+    buffer = allocator.createBuffer(regionSize * regionCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation);
+    beginFrame(0);
+}
+
+void UniformRing::cleanup(DeviceAllocator& allocator) {
+    allocator.destroyBuffer(buffer, allocation);
+    regionCount = 0;
+}
+
+void UniformRing::beginFrame(uint32_t region) {
+    if (region >= regionCount) { throw std::runtime_error("uniform ring region out of range!"); }
+    regionStart = regionSize * region;
+    cursor = 0;
+}
+
+UniformSlice UniformRing::allocate(VkDeviceSize size) {
+    if (cursor + size > regionSize) { throw std::runtime_error("uniform ring region overflow!"); }
+
+    UniformSlice slice;
+    slice.offset = static_cast<uint32_t>(regionStart + cursor);
+    slice.data = static_cast<char*>(allocation.mapped) + regionStart + cursor;
+    cursor += (size + alignment - 1) / alignment * alignment;
+    return slice;
+}
@@ -0,0 +1,56 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+
+// A chunk of the ring handed out for one frame
+struct UniformSlice {
+    void* data = nullptr;
+    // Offset from the start of the ring buffer, passed to vkCmdBindDescriptorSets as a dynamic offset
+    uint32_t offset = 0;
+};
+
+// One persistently mapped, host-coherent uniform buffer split into a region per frame slot. Each frame
+// linearly allocates from its own region (beginFrame() rewinds it), and descriptors of type
+// UNIFORM_BUFFER_DYNAMIC select the data with the returned offsets, so a single descriptor set serves
+// every frame and nothing is mapped or unmapped per frame.
+//
+// A region may only be rewound once the GPU has finished the frame that last used it; the caller
+// guarantees that with its in-flight fences. Allocations are deterministic: the same sequence of
+// allocate() calls after beginFrame() yields the same offsets, which is what lets prerecorded command
+// buffers bake the dynamic offsets in.
+class UniformRing {
+public:
+    void init(DeviceAllocator& allocator, VkPhysicalDevice physicalDevice, VkDeviceSize regionSize, uint32_t regionCount);
+    void cleanup(DeviceAllocator& allocator);
+
+    void beginFrame(uint32_t region);
+    UniformSlice allocate(VkDeviceSize size);
+
+    template <typename T>
+    UniformSlice push(const T& value) {
+        UniformSlice slice = allocate(sizeof(T));
+        *static_cast<T*>(slice.data) = value;
+        return slice;
+    }
+
+    [[nodiscard]] VkBuffer getBuffer() const { return buffer; }
+    [[nodiscard]] uint32_t getRegionCount() const { return regionCount; }
+
+private:
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+    VkDeviceSize alignment = 256;
+    VkDeviceSize regionSize = 0;
+    uint32_t regionCount = 0;
+
+    VkDeviceSize regionStart = 0;
+    VkDeviceSize cursor = 0;
+};
+
+#endif // UNIFORM_RING_H
@@ -0,0 +1,211 @@
+#include "UploadManager.h"
+#include "VulkanException.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void UploadManager::init(DeviceAllocator& deviceAllocator, VkDevice dev, VkQueue uploadQueue, uint32_t queueFamily,
+                         uint32_t graphicsFamily, VkDeviceSize size) {
+    allocator = &deviceAllocator;
+    device = dev;
+    queue = uploadQueue;
+    queueFamilies = {queueFamily};
+    if (graphicsFamily != queueFamily) { queueFamilies.push_back(graphicsFamily); }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "failed to create upload command pool!");
+
+    stagingSize = size;
+    maxChunkSize = stagingSize / 4;
+    stagingBuffer = allocator->createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingAllocation);
+}
+
+void UploadManager::cleanup() {
+    if (device == VK_NULL_HANDLE) { return; }
+    waitIdle();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batchOpen) { freeBatches.push_back(openBatch); }
+    for (auto& batch : freeBatches) { vkDestroyFence(device, batch.fence, nullptr); }
+    freeBatches.clear();
+    batchOpen = false;
+
+    // Destroying the pool frees the batches' command buffers
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    allocator->destroyBuffer(stagingBuffer, stagingAllocation);
+    device = VK_NULL_HANDLE;
+}
+
+UploadTicket UploadManager::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    TRACE_SCOPE("UploadManager::uploadBuffer");
+    std::lock_guard<std::mutex> lock(mutex);
+    const char* source = static_cast<const char*>(data);
+    UploadTicket ticket = completedTicket;
+
+    while (size > 0) {
+        VkDeviceSize chunk = std::min(size, maxChunkSize);
+        VkDeviceSize stagingOffset = 0;
+        while (true) {
+            if (!batchOpen) { beginBatch(); }
+            if (tryReserveStaging(chunk, stagingOffset)) { break; }
+
+            // Ring full: send what is recorded so far and wait for the oldest batch to hand back its space
+            stagingStalls++;
+            if (openBatch.copyCount > 0) { submitOpenBatch(); }
+            retireCompleted(true);
+        }
+
+        memcpy(static_cast<char*>(stagingAllocation.mapped) + stagingOffset, source, static_cast<size_t>(chunk));
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = chunk;
+        vkCmdCopyBuffer(openBatch.commandBuffer, stagingBuffer, dst, 1, &copyRegion);
+        openBatch.copyCount++;
+        ticket = openBatch.ticket;
+
+        source += chunk;
+        dstOffset += chunk;
+        size -= chunk;
+        uploadedBytes += chunk;
+    }
+
+    return ticket;
+}
+
+UploadTicket UploadManager::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batchOpen && openBatch.copyCount > 0) { return submitOpenBatch(); }
+    return nextTicket - 1;
+}
+
+bool UploadManager::isComplete(UploadTicket ticket) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retireCompleted(false);
+    return completedTicket >= ticket;
+}
+
+void UploadManager::wait(UploadTicket ticket) {
+    TRACE_SCOPE("UploadManager::wait");
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batchOpen && openBatch.copyCount > 0 && openBatch.ticket <= ticket) { submitOpenBatch(); }
+    while (completedTicket < ticket && !inFlight.empty()) { retireCompleted(true); }
+}
+
+void UploadManager::waitIdle() {
+    wait(flush());
+}
+
+void UploadManager::beginBatch() {
+    if (!freeBatches.empty()) {
+        openBatch = freeBatches.back();
+        freeBatches.pop_back();
+        VK_CHECK(vkResetFences(device, 1, &openBatch.fence), "failed to reset upload fence!");
+        VK_CHECK(vkResetCommandBuffer(openBatch.commandBuffer, 0), "failed to reset upload command buffer!");
+    } else {
+        openBatch = Batch{};
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &openBatch.commandBuffer), "failed to allocate upload command buffer!");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &openBatch.fence), "failed to create upload fence!");
+    }
+
+    openBatch.ticket = nextTicket;
+    openBatch.stagingBytes = 0;
+    openBatch.stagingEnd = stagingHead;
+    openBatch.copyCount = 0;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(openBatch.commandBuffer, &beginInfo), "failed to begin upload command buffer!");
+    batchOpen = true;
+}
+
+UploadTicket UploadManager::submitOpenBatch() {
+    VK_CHECK(vkEndCommandBuffer(openBatch.commandBuffer), "failed to record upload command buffer!");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &openBatch.commandBuffer;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, openBatch.fence), "failed to submit upload batch!");
+
+    inFlight.push_back(openBatch);
+    batchOpen = false;
+    nextTicket++;
+    submittedBatches++;
+    return inFlight.back().ticket;
+}
+
+void UploadManager::retireCompleted(bool waitForOldest) {
+    // Batches on one queue finish in submission order, so retiring from the front keeps the ring contiguous
+    while (!inFlight.empty()) {
+        Batch& batch = inFlight.front();
+        if (waitForOldest) {
+            VK_CHECK(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX), "failed to wait for upload batch!");
+            waitForOldest = false;
+        } else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+            break;
+        }
+
+        stagingUsed -= batch.stagingBytes;
+        stagingTail = batch.stagingEnd;
+        completedTicket = batch.ticket;
+        freeBatches.push_back(batch);
+        inFlight.pop_front();
+    }
+}
+
+bool UploadManager::tryReserveStaging(VkDeviceSize size, VkDeviceSize& offset) {
+    size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (stagingUsed == 0) {
+        stagingHead = 0;
+        stagingTail = 0;
+    }
+
+    VkDeviceSize skipped = 0;
+    if (stagingUsed > 0 && stagingHead == stagingTail) {
+        return false;
+    } else if (stagingHead >= stagingTail) {
+        // Free space is [head, end) plus [0, tail); a request that does not fit at the end wraps around
+        if (stagingHead + size <= stagingSize) {
+            offset = stagingHead;
+        } else if (size <= stagingTail) {
+            skipped = stagingSize - stagingHead;
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else {
+        if (stagingHead + size > stagingTail) { return false; }
+        offset = stagingHead;
+    }
+
+    stagingHead = offset + size;
+    stagingUsed += skipped + size;
+    openBatch.stagingBytes += skipped + size;
+    openBatch.stagingEnd = stagingHead;
+    return true;
+}
+
+void UploadManager::printStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Uploads: " << static_cast<double>(uploadedBytes) / (1024.0 * 1024.0) << " MiB in " << submittedBatches
+              << " batches on the " << (usesTransferQueue() ? "transfer" : "graphics") << " queue, "
+              << stagingStalls << " staging stalls\n";
+}
@@ -0,0 +1,95 @@
+#ifndef UPLOAD_MANAGER_H
+#define UPLOAD_MANAGER_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "MemoryAllocator.h"
+
+// Identifies a submitted (or still open) batch of uploads; tickets increase monotonically
+using UploadTicket = uint64_t;
+
+// Batches buffer uploads through a persistently mapped staging ring. Copies are recorded into one open
+// command buffer and go out together on flush(), on a transfer-only queue when the device has one.
+// Completion is tracked with one fence per batch; the staging space of a batch is reused once its fence
+// has signaled, and uploads larger than the free space are split into chunks.
+//
+// Work that reads uploaded data must not be submitted before wait() returns for its ticket. With a
+// dedicated transfer family, destination buffers must be shared with the graphics family
+// (see getQueueFamilies()), so no queue family ownership transfer is needed.
+// Thread safe, but when the manager shares the graphics queue, flush() must not race rendering submits.
+class UploadManager {
+public:
+    void init(DeviceAllocator& allocator, VkDevice device, VkQueue queue, uint32_t queueFamily,
+              uint32_t graphicsFamily, VkDeviceSize stagingSize);
+    void cleanup();
+
+    // Copies size bytes from data into dst at dstOffset as part of the open batch.
+    // Returns the ticket of the batch that holds the last chunk.
+    UploadTicket uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Submits the open batch (if it has any copies) and returns its ticket
+    UploadTicket flush();
+    [[nodiscard]] bool isComplete(UploadTicket ticket);
+    void wait(UploadTicket ticket);
+    void waitIdle();
+
+    // Queue families that destination buffers must be created for (one entry when no transfer queue is used)
+    [[nodiscard]] const std::vector<uint32_t>& getQueueFamilies() const { return queueFamilies; }
+    [[nodiscard]] bool usesTransferQueue() const { return queueFamilies.size() > 1; }
+
+    void printStats() const;
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        UploadTicket ticket = 0;
+        // Staging bytes consumed (including space skipped when wrapping) and the ring position after them
+        VkDeviceSize stagingBytes = 0;
+        VkDeviceSize stagingEnd = 0;
+        uint32_t copyCount = 0;
+    };
+
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    DeviceAllocator* allocator = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    std::vector<uint32_t> queueFamilies;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    Allocation stagingAllocation;
+    VkDeviceSize stagingSize = 0;
+    // Larger copies are split, so one big upload cannot monopolize the ring
+    VkDeviceSize maxChunkSize = 0;
+    VkDeviceSize stagingHead = 0;
+    VkDeviceSize stagingTail = 0;
+    VkDeviceSize stagingUsed = 0;
+
+    Batch openBatch;
+    bool batchOpen = false;
+    std::deque<Batch> inFlight;
+    std::vector<Batch> freeBatches;
+    UploadTicket nextTicket = 1;
+    UploadTicket completedTicket = 0;
+
+    uint64_t uploadedBytes = 0;
+    uint64_t submittedBatches = 0;
+    uint64_t stagingStalls = 0;
+
+    mutable std::mutex mutex;
+
+    void beginBatch();
+    UploadTicket submitOpenBatch();
+    void retireCompleted(bool waitForOldest);
+    bool tryReserveStaging(VkDeviceSize size, VkDeviceSize& offset);
+};
+
+#endif // UPLOAD_MANAGER_H
@@ -1,20 +1,45 @@
 #include "VulkanApp.h"
+#include "ParallelFor.h"
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
 #include <array>
 #include <set>
 #include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <filesystem>
+#include <iomanip>
+
+VulkanApp::VulkanApp(const AppConfig& appConfig) : config(appConfig) {
+    if (config.benchmark && config.frameCount == 0) { config.frameCount = DEFAULT_BENCHMARK_FRAME_COUNT; }
+    if (config.headless && config.frameCount == 0) { config.frameCount = DEFAULT_HEADLESS_FRAME_COUNT; }
+}
 
 void VulkanApp::run() {
-    std::cout << "Initializing window..." << std::endl;
-    initWindow();
-    std::cout << "Initializing Vulkan..." << std::endl;
+    if (!config.traceOutput.empty()) {
+        Trace::setEnabled(true);
+        Trace::setThreadName("main");
+    }
+
+    auto startupBegin = std::chrono::steady_clock::now();
+    if (!config.headless) {
+        std::cout << "Initializing window...\n";
+        initWindow();
+    }
+    double windowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    std::cout << "Initializing Vulkan...\n";
     initVulkan();
+    double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    std::cout << "Startup took " << startupMs << " ms (window " << windowMs << " ms)" << std::endl;
     std::cout << "Entering main loop..." << std::endl;
     mainLoop();
     std::cout << "Cleaning up..." << std::endl;
     cleanup();
+
+    if (!config.traceOutput.empty()) { Trace::writeChromeTrace(config.traceOutput); }
 }
 
 void VulkanApp::initWindow() {
@@ -23,109 +48,283 @@ void VulkanApp::initWindow() {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-    window = glfwCreateWindow(WIDTH, HEIGHT, WINDOW_TITLE, nullptr, nullptr);
+    window = glfwCreateWindow(static_cast<int>(config.width), static_cast<int>(config.height), WINDOW_TITLE, nullptr, nullptr);
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
         (void)width; (void)height; // Suppress unused parameter warnings
         static_cast<VulkanApp*>(glfwGetWindowUserPointer(window))->framebufferResized = true;
     });
+
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    framebufferExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 }
 
 void VulkanApp::initVulkan() {
-    std::cout << "Creating instance..." << std::endl;
-    createInstance();
-    std::cout << "Setting up debug messenger..." << std::endl;
-    setupDebugMessenger();
-    std::cout << "Creating surface..." << std::endl;
-    createSurface();
-    std::cout << "Picking physical device..." << std::endl;
-    pickPhysicalDevice();
-    std::cout << "Creating logical device..." << std::endl;
-    createLogicalDevice();
-    std::cout << "Creating swap chain..." << std::endl;
-    createSwapChain();
-    std::cout << "Creating image views..." << std::endl;
-    createImageViews();
-    std::cout << "Creating render pass..." << std::endl;
-    createRenderPass();
-    std::cout << "Creating descriptor set layout..." << std::endl;
-    createDescriptorSetLayout();
-    std::cout << "Creating graphics pipeline..." << std::endl;
-    createGraphicsPipeline();
-    std::cout << "Creating framebuffers..." << std::endl;
-    createFramebuffers();
-    std::cout << "Creating command pool..." << std::endl;
-    createCommandPool();
-    std::cout << "Creating cube mesh..." << std::endl;
-    createCubeMesh();
-    std::cout << "Creating uniform buffers..." << std::endl;
-    createUniformBuffers();
-    std::cout << "Creating descriptor pool..." << std::endl;
-    createDescriptorPool();
-    std::cout << "Creating descriptor sets..." << std::endl;
-    createDescriptorSets();
-    std::cout << "Creating command buffers..." << std::endl;
-    createCommandBuffers();
-    std::cout << "Creating sync objects..." << std::endl;
-    createSyncObjects();
+    // Steps only wait on the steps whose handles or data they consume. Loading SPIR-V and building the
+    // cube geometry need no Vulkan objects at all and overlap instance/device creation, while the
+    // swapchain, render pass -> pipeline and mesh upload chains run side by side once the device exists.
+    TaskGraph graph;
+    auto shaderCode = graph.add("loadShaderCode", [this]() { loadShaderCode(); });
+    auto cubeGeometry = graph.add("generateCubeMesh", [this]() { generateCubeMesh(); });
+
+    auto instanceTask = graph.add("createInstance", [this]() { createInstance(); });
+    auto debugTask = graph.add("setupDebugMessenger", [this]() { setupDebugMessenger(); }, {instanceTask});
+    std::vector<TaskGraph::TaskId> physicalDeviceDeps = {debugTask};
+    if (!config.headless) { physicalDeviceDeps.push_back(graph.add("createSurface", [this]() { createSurface(); }, {debugTask})); }
+    auto physicalDeviceTask = graph.add("pickPhysicalDevice", [this]() { pickPhysicalDevice(); }, physicalDeviceDeps);
+    auto deviceTask = graph.add("createLogicalDevice", [this]() { createLogicalDevice(); }, {physicalDeviceTask});
+    auto formatTask = graph.add("chooseSurfaceFormat", [this]() { chooseSurfaceFormat(); }, {physicalDeviceTask});
+
+    auto targetsTask = config.headless
+        ? graph.add("createOffscreenTargets", [this]() { createOffscreenTargets(); }, {deviceTask, formatTask})
+        : graph.add("createSwapChain", [this]() { createSwapChain(); }, {deviceTask, formatTask});
+    auto imageViewsTask = graph.add("createImageViews", [this]() { createImageViews(); }, {targetsTask});
+    auto renderPassTask = graph.add("createRenderPass", [this]() { createRenderPass(); }, {deviceTask, formatTask});
+    auto setLayoutTask = graph.add("createDescriptorSetLayout", [this]() { createDescriptorSetLayout(); }, {deviceTask});
+    // The vertex input layouts of both pipelines come from the mesh's format and stream split
+    auto pipelineTask = graph.add("createGraphicsPipeline", [this]() { createGraphicsPipeline(); },
+                                  {renderPassTask, setLayoutTask, shaderCode, cubeGeometry});
+    auto depthTask = graph.add("createDepthResources", [this]() { createDepthResources(); }, {targetsTask, renderPassTask});
+    auto framebuffersTask = graph.add("createFramebuffers", [this]() { createFramebuffers(); }, {imageViewsTask, depthTask});
+    auto commandPoolTask = graph.add("createCommandPool", [this]() { createCommandPool(); }, {deviceTask});
+    auto uploadTask = graph.add("createUploadManager", [this]() { createUploadManager(); }, {deviceTask});
+    auto meshTask = graph.add("createCubeMesh", [this]() { createCubeMesh(); }, {uploadTask, cubeGeometry});
+    auto uniformsTask = graph.add("createUniformRing", [this]() { createUniformRing(); }, {targetsTask});
+    auto descriptorPoolTask = graph.add("createDescriptorPool", [this]() { createDescriptorPool(); }, {deviceTask});
+    std::vector<TaskGraph::TaskId> descriptorSetsDeps = {descriptorPoolTask, setLayoutTask, uniformsTask};
+    if (config.gpuCulling) {
+        descriptorSetsDeps.push_back(graph.add("createCullPipeline", [this]() { createCullPipeline(); }, {deviceTask, shaderCode}));
+    }
+    auto descriptorSetsTask = graph.add("createDescriptorSets", [this]() { createDescriptorSets(); }, descriptorSetsDeps);
+    std::vector<TaskGraph::TaskId> commandBufferDeps = {commandPoolTask, framebuffersTask, pipelineTask, meshTask, descriptorSetsTask};
+    // A sweep starts from a single instance
+    uint32_t initialInstances = config.instanceSweep ? 1 : config.instanceCount;
+    // The BVH is built over the instances' bounds, which need the mesh's
+    std::vector<TaskGraph::TaskId> instanceBufferDeps = {uploadTask};
+    if (config.bvhCulling) { instanceBufferDeps.push_back(cubeGeometry); }
+    // Animated instances get a region per swapchain image
+    if (config.animateInstances) { instanceBufferDeps.push_back(targetsTask); }
+    auto instanceBufferTask = graph.add("createInstanceBuffer", [this, initialInstances]() { createInstanceBuffer(initialInstances); }, instanceBufferDeps);
+    commandBufferDeps.push_back(instanceBufferTask);
+    if (config.gpuCulling) {
+        commandBufferDeps.push_back(graph.add("createCullBuffers", [this]() { createCullBuffers(); }, {instanceBufferTask, descriptorSetsTask}));
+    }
+    if (config.meshletCulling) {
+        commandBufferDeps.push_back(graph.add("createMeshletCommandBuffer", [this]() { createMeshletCommandBuffer(); }, {targetsTask, cubeGeometry}));
+    }
+    if (config.bvhCulling && !config.perFrameRecording) {
+        commandBufferDeps.push_back(graph.add("createBvhCommandBuffer", [this]() { createBvhCommandBuffer(); }, {targetsTask}));
+    }
+    if (config.perFrameRecording) {
+        commandBufferDeps.push_back(graph.add("createFrameRecorders", [this]() { createFrameRecorders(); }, {deviceTask}));
+    } else if (config.animateInstances) {
+        graph.add("startFrameWorkers", [this]() { frameWorkers.start(0); }, {});
+    }
+    if (config.gpuProfile) {
+        commandBufferDeps.push_back(graph.add("initGpuProfiler", [this]() {
+            gpuProfiler.init(physicalDevice, device, findQueueFamilies(physicalDevice).graphicsFamily.value(),
+                             static_cast<uint32_t>(swapChainImages.size()));
+        }, {targetsTask}));
+    }
+    graph.add("createCommandBuffers", [this]() { createCommandBuffers(); }, commandBufferDeps);
+    graph.add("createSyncObjects", [this]() { createSyncObjects(); }, {targetsTask});
+
+    uint32_t threadCount = config.initThreads;
+    if (threadCount == 0) { threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_INIT_THREADS)); }
+    graph.run(threadCount);
+
+    // Mesh uploads were only flushed, so they overlapped the rest of init; they must land before the first frame
+    uploadManager.waitIdle();
+
+    graph.printReport(std::cout);
+    allocator.printStats();
+    uploadManager.printStats();
     std::cout << "Vulkan initialization complete!" << std::endl;
 }
 
 void VulkanApp::mainLoop() {
     std::cout << "Starting main loop..." << std::endl;
-    int frameCount = 0;
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        drawFrame();
-        frameCount++;
-        if (frameCount % 100 == 0) { std::cout << "Rendered " << frameCount << " frames" << std::endl; }
+    std::optional<FrameBenchmark> benchmark;
+    uint32_t frameCount = 0;
+    if (config.instanceSweep) {
+        frameCount = runInstanceSweep();
+    } else {
+        uint32_t targetFrames = config.frameCount;
+        if (config.benchmark) {
+            benchmark.emplace(config.warmupFrames, config.frameCount);
+            targetFrames = benchmark->totalFrames();
+            std::cout << "Benchmarking: " << config.warmupFrames << " warm-up + " << config.frameCount << " measured frames" << std::endl;
+        }
+        frameCount = renderFrames(targetFrames, benchmark ? &*benchmark : nullptr);
     }
     std::cout << "Main loop finished after " << frameCount << " frames" << std::endl;
 
     vkDeviceWaitIdle(device);
+
+    gpuProfiler.printSummary();
+
+    if (config.meshletCulling) {
+        uint64_t tested = meshletCullTotals.visible + meshletCullTotals.frustumCulled + meshletCullTotals.backfaceCulled;
+        std::cout << "Meshlet culling: " << meshletCullTotals.visible << " of " << tested << " meshlets drawn, "
+                  << meshletCullTotals.frustumCulled << " outside the frustum, " << meshletCullTotals.backfaceCulled
+                  << " back-facing" << std::endl;
+    }
+    if (config.bvhCulling && bvhCullFrames > 0) {
+        std::cout << "BVH culling: " << bvhCullTotals.visible / bvhCullFrames << " of " << drawInstanceCount
+                  << " instances visible per frame, " << bvhCullTotals.drawn / bvhCullFrames << " drawn in "
+                  << bvhCullTotals.ranges / bvhCullFrames << " ranges, " << bvhCullTotals.nodesVisited / bvhCullFrames
+                  << " nodes visited" << std::endl;
+    }
+
+    if (benchmark) {
+        benchmark->printSummary();
+        benchmark->writeJson(config.benchmarkOutput, describeBenchmark());
+    }
+
+    if (config.headless && !config.outputImage.empty() && frameCount > 0) {
+        // drawFrame() has already advanced currentFrame, so the last image is one slot back
+        uint32_t lastImage = static_cast<uint32_t>((currentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT);
+        saveOffscreenImage(lastImage, config.outputImage);
+    }
+}
+
+uint32_t VulkanApp::renderFrames(uint32_t targetFrames, FrameBenchmark* benchmark) {
+    uint32_t frameCount = 0;
+    while (targetFrames == 0 || frameCount < targetFrames) {
+        auto frameStart = BenchmarkClock::now();
+        if (!config.headless) {
+            if (glfwWindowShouldClose(window)) { break; }
+            glfwPollEvents();
+        }
+        // A frame lost to swapchain recreation has partial timings and shows nothing, so it is not counted
+        if (!drawFrame()) { continue; }
+        frameCount++;
+        frameTimings.frameMs = millisecondsBetween(frameStart, BenchmarkClock::now());
+
+        // Capture what led up to a stalled frame while it is still in the ring buffers. Each stall gets its
+        // own file (trace.json -> trace_stall_<frame>.json, numbered by submitted frame so sweep steps do not
+        // collide), which the exit dump to traceOutput cannot overwrite.
+        if (config.traceStallMs > 0.0 && frameTimings.frameMs > config.traceStallMs && !config.traceOutput.empty()) {
+            std::filesystem::path stallOutput(config.traceOutput);
+            stallOutput.replace_filename(stallOutput.stem().string() + "_stall_" + std::to_string(submittedFrame)
+                                         + stallOutput.extension().string());
+            std::cout << "Frame " << submittedFrame << " took " << frameTimings.frameMs << " ms, dumping trace to "
+                      << stallOutput.string() << std::endl;
+            Trace::writeChromeTrace(stallOutput.string());
+        }
+
+        if (benchmark) {
+            // Console output would skew the measurement, so the benchmark stays silent
+            benchmark->addFrame(frameTimings);
+        }
+        else if (frameCount % 100 == 0) { std::cout << "Rendered " << frameCount << " frames" << std::endl; }
+    }
+    return frameCount;
+}
+
+uint32_t VulkanApp::runInstanceSweep() {
+    struct SweepStep {
+        uint32_t instances;
+        PercentileSummary frame;
+        double fps;
+    };
+    std::vector<SweepStep> steps;
+    uint32_t frameCount = 0;
+
+    std::cout << "Instance sweep: 1 to " << config.instanceCount << " instances, " << config.warmupFrames << " warm-up + "
+              << config.frameCount << " measured frames each" << std::endl;
+    // Powers of ten, ending at the requested count itself even when it is not one
+    std::vector<uint32_t> counts;
+    for (uint64_t count = 1; count < config.instanceCount; count *= 10) { counts.push_back(static_cast<uint32_t>(count)); }
+    counts.push_back(config.instanceCount);
+    for (uint32_t count : counts) {
+        setInstanceCount(count);
+        FrameBenchmark benchmark(config.warmupFrames, config.frameCount);
+        frameCount += renderFrames(benchmark.totalFrames(), &benchmark);
+        // The window was closed mid-step
+        if (!benchmark.isComplete()) { break; }
+
+        // results.json -> results_1000.json
+        std::filesystem::path output(config.benchmarkOutput);
+        output.replace_filename(output.stem().string() + "_" + std::to_string(count) + output.extension().string());
+        benchmark.writeJson(output.string(), describeBenchmark());
+        steps.push_back({count, benchmark.frameTimeSummary(), benchmark.framesPerSecond()});
+    }
+
+    std::cout << std::fixed << std::setprecision(3) << "Instance sweep results:\n"
+              << "  instances    mean ms     p99 ms        FPS   M instances/s\n";
+    for (const SweepStep& step : steps) {
+        std::cout << "  " << std::setw(9) << step.instances << std::setw(11) << step.frame.mean << std::setw(11) << step.frame.p99
+                  << std::setw(11) << step.fps << std::setw(16) << step.fps * step.instances / 1e6 << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6) << std::flush;
+    return frameCount;
 }
 
 void VulkanApp::cleanup() {
+    frameWorkers.stop();
     cleanupSwapChain();
+    // The device is idle here, so everything still queued can go
+    deletionQueue.flush();
+
+    cubeMesh.cleanup(allocator);
+    if (meshletCommandBuffer != VK_NULL_HANDLE) { allocator.destroyBuffer(meshletCommandBuffer, meshletCommandAllocation); }
+    if (bvhCommandBuffer != VK_NULL_HANDLE) { allocator.destroyBuffer(bvhCommandBuffer, bvhCommandAllocation); }
+    allocator.destroyBuffer(instanceBuffer, instanceAllocation);
+    if (drawCommandBuffer != VK_NULL_HANDLE) {
+        allocator.destroyBuffer(visibleInstanceBuffer, visibleInstanceAllocation);
+        allocator.destroyBuffer(drawCommandBuffer, drawCommandAllocation);
+    }
 
-    cubeMesh.cleanup(device);
+    gpuProfiler.cleanup();
 
     // Destroy per-frame fences
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
     
-    // Destroy per-image semaphores
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-    }
-
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-        vkDestroyBuffer(device, lightingBuffers[i], nullptr);
-        vkFreeMemory(device, lightingBuffersMemory[i], nullptr);
+    uniformRing.cleanup(allocator);
+
+    if (depthPrepassPipeline != VK_NULL_HANDLE) { vkDestroyPipeline(device, depthPrepassPipeline, nullptr); }
+    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyRenderPass(device, renderPass, nullptr);
+    if (cullPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
     }
 
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
+    // Destroying a pool frees its command buffers
+    for (FrameRecorder& recorder : frameRecorders) {
+        vkDestroyCommandPool(device, recorder.primaryPool, nullptr);
+        for (RecordWorker& worker : recorder.workers) { vkDestroyCommandPool(device, worker.pool, nullptr); }
+    }
+    uploadManager.cleanup();
+    allocator.cleanup();
     vkDestroyDevice(device, nullptr);
     
     if constexpr (enableValidationLayers) {
         destroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
     
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE) { vkDestroySurfaceKHR(instance, surface, nullptr); }
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window != nullptr) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
 
 void VulkanApp::createInstance() {
+    TRACE_SCOPE("createInstance");
     std::cout << "  Creating Vulkan instance..." << std::endl;
     
     if constexpr (enableValidationLayers) {
@@ -182,6 +381,7 @@ void VulkanApp::createInstance() {
 }
 
 void VulkanApp::setupDebugMessenger() {
+    TRACE_SCOPE("setupDebugMessenger");
     if constexpr (!enableValidationLayers) return;
 
     VkDebugUtilsMessengerCreateInfoEXT createInfo{};
@@ -198,9 +398,13 @@ void VulkanApp::setupDebugMessenger() {
              "Failed to set up debug messenger!");
 }
 
-void VulkanApp::createSurface() { if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) { throw std::runtime_error("failed to create window surface!"); } }
+void VulkanApp::createSurface() {
+    TRACE_SCOPE("createSurface");
+    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) { throw std::runtime_error("failed to create window surface!"); }
+}
 
 void VulkanApp::pickPhysicalDevice() {
+    TRACE_SCOPE("pickPhysicalDevice");
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -217,13 +421,19 @@ void VulkanApp::pickPhysicalDevice() {
     }
 
     if (physicalDevice == VK_NULL_HANDLE) { throw std::runtime_error("failed to find a suitable GPU!"); }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    std::cout << "  Using device: " << properties.deviceName << "\n";
 }
 
 void VulkanApp::createLogicalDevice() {
+    TRACE_SCOPE("createLogicalDevice");
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    if (indices.transferFamily.has_value()) { uniqueQueueFamilies.insert(indices.transferFamily.value()); }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -235,7 +445,22 @@ void VulkanApp::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures{};
+    // Lets meshlet and BVH culling issue all of a frame's indirect draws in one call instead of one per command
+    if ((config.meshletCulling || config.bvhCulling) && supportedFeatures.multiDrawIndirect) {
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+    }
+    // Prerecorded BVH culling draws each visible range of instances with its own firstInstance. Per-frame
+    // recording issues direct draws instead, which take any firstInstance without the feature.
+    if (config.bvhCulling && !config.perFrameRecording) {
+        if (!supportedFeatures.drawIndirectFirstInstance) { throw std::runtime_error("BVH culling requires drawIndirectFirstInstance (or --record-per-frame)!"); }
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -245,9 +470,49 @@ void VulkanApp::createLogicalDevice() {
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    const std::vector<const char*> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    };
+    // Headless rendering never presents, so it must not require the swapchain extension
+    std::vector<const char*> deviceExtensions;
+    if (!config.headless) { deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME); }
+
+    // GPU culling dispatches on the graphics queue
+    if (config.gpuCulling) {
+        // The cull pass binds the whole instance buffers and dispatches one invocation per instance; the
+        // largest count is config.instanceCount, which is also where an instance sweep ends
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        uint64_t bufferInstances = properties.limits.maxStorageBufferRange / sizeof(InstanceData);
+        uint64_t dispatchInstances = static_cast<uint64_t>(properties.limits.maxComputeWorkGroupCount[0]) * CULL_GROUP_SIZE;
+        uint64_t maxInstances = std::min(bufferInstances, dispatchInstances);
+        if (config.instanceCount > maxInstances) {
+            throw std::runtime_error("GPU culling supports at most " + std::to_string(maxInstances) + " instances on this device!");
+        }
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (!(families[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            throw std::runtime_error("GPU culling requires a graphics queue with compute support!");
+        }
+    }
+
+    // With a draw count in the buffer, culled draws are skipped instead of issued with zero instances
+    bool drawIndirectCount = false;
+    if (config.gpuCulling || config.bvhCulling) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+        for (const auto& extension : extensions) {
+            if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) { drawIndirectCount = true; }
+        }
+        if (drawIndirectCount) { deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME); }
+    }
+    // Prerecorded BVH draws cover all MAX_BVH_DRAW_RANGES commands; with neither feature that would be
+    // thousands of single indirect calls per pass, nearly all of them with zero instances
+    if (config.bvhCulling && !config.perFrameRecording && !drawIndirectCount && !supportedFeatures.multiDrawIndirect) {
+        throw std::runtime_error("BVH culling requires VK_KHR_draw_indirect_count or multiDrawIndirect (or --record-per-frame)!");
+    }
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
@@ -258,28 +523,29 @@ void VulkanApp::createLogicalDevice() {
 
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    if (indices.transferFamily.has_value()) { vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue); }
+
+    if (drawIndirectCount) {
+        cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+
+    allocator.init(physicalDevice, device);
 }
 
 void VulkanApp::createSwapChain() {
-    std::cout << "  Creating swap chain..." << std::endl;
+    TRACE_SCOPE("createSwapChain");
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
-    std::cout << "  Swap chain support queried..." << std::endl;
 
-    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    std::cout << "  Surface format chosen..." << std::endl;
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-    std::cout << "  Present mode chosen..." << std::endl;
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-    std::cout << "  Swap extent chosen..." << std::endl;
 
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) { imageCount = swapChainSupport.capabilities.maxImageCount; }
-    std::cout << "  Image count: " << imageCount << std::endl;
 
     VkSwapchainCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.surface = surface;
-    std::cout << "  Surface: " << surface << std::endl;
 
     createInfo.minImageCount = imageCount;
     createInfo.imageFormat = surfaceFormat.format;
@@ -303,17 +569,9 @@ void VulkanApp::createSwapChain() {
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
-
-    std::cout << "  Creating swap chain with device: " << device << std::endl;
-    std::cout << "  Physical device: " << physicalDevice << std::endl;
-    std::cout << "  Surface format: " << surfaceFormat.format << std::endl;
-    std::cout << "  Color space: " << surfaceFormat.colorSpace << std::endl;
-    std::cout << "  Extent: " << extent.width << "x" << extent.height << std::endl;
-    std::cout << "  Present mode: " << presentMode << std::endl;
-    std::cout << "  Pre-transform: " << swapChainSupport.capabilities.currentTransform << std::endl;
-    std::cout << "  Image usage: " << createInfo.imageUsage << std::endl;
-    std::cout << "  Sharing mode: " << createInfo.imageSharingMode << std::endl;
+    // On recreation the retired swapchain is handed over so presentation can continue without a stall;
+    // cleanupSwapChain() has queued it for destruction once its frames are done
+    createInfo.oldSwapchain = swapChain;
 
     VkResult result = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain);
     if (result != VK_SUCCESS) {
@@ -343,7 +601,6 @@ void VulkanApp::createSwapChain() {
         }
         throw std::runtime_error("failed to create swap chain!");
     }
-    std::cout << "  Swap chain created successfully!" << std::endl;
 
     vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
     swapChainImages.resize(imageCount);
@@ -351,10 +608,53 @@ void VulkanApp::createSwapChain() {
 
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = extent;
-    std::cout << "  Swap chain images retrieved!" << std::endl;
+    swapChainPresentMode = presentMode;
+    std::cout << "  Swap chain: " << imageCount << " images, " << extent.width << "x" << extent.height
+              << ", format " << surfaceFormat.format << ", present mode " << presentMode << "\n";
+}
+
+void VulkanApp::chooseSurfaceFormat() {
+    TRACE_SCOPE("chooseSurfaceFormat");
+    // Chosen once up front so the render pass (and the pipeline built on it) need not wait for the swapchain
+    if (config.headless) {
+        surfaceFormat = {VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+        return;
+    }
+    surfaceFormat = chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+}
+
+void VulkanApp::createOffscreenTargets() {
+    TRACE_SCOPE("createOffscreenTargets");
+    // One render target per frame in flight: the in-flight fence of a frame then also guards its image
+    swapChainImageFormat = surfaceFormat.format;
+    swapChainExtent = {config.width, config.height};
+
+    swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    offscreenImagesAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = swapChainImageFormat;
+        imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        swapChainImages[i] = allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreenImagesAllocation[i]);
+    }
+
+    std::cout << "  Offscreen targets: " << swapChainImages.size() << " x "
+              << swapChainExtent.width << "x" << swapChainExtent.height << "\n";
 }
 
 void VulkanApp::createImageViews() {
+    TRACE_SCOPE("createImageViews");
     swapChainImageViews.resize(swapChainImages.size());
 
     for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -378,37 +678,58 @@ void VulkanApp::createImageViews() {
 }
 
 void VulkanApp::createRenderPass() {
+    TRACE_SCOPE("createRenderPass");
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swapChainImageFormat;
+    colorAttachment.format = surfaceFormat.format;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen targets are left ready for readback instead of presentation
+    colorAttachment.finalLayout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // Depth is only needed while the pass runs, so it is cleared on load and never stored
+    depthFormat = findDepthFormat();
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+    // The depth clear must also wait for the previous depth writes to the same image
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
     renderPassInfo.dependencyCount = 1;
@@ -417,17 +738,55 @@ void VulkanApp::createRenderPass() {
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) { throw std::runtime_error("failed to create render pass!"); }
 }
 
+void VulkanApp::createDepthResources() {
+    TRACE_SCOPE("createDepthResources");
+    depthImages.resize(swapChainImages.size());
+    depthImageAllocations.resize(swapChainImages.size());
+    depthImageViews.resize(swapChainImages.size());
+
+    VkImageAspectFlags aspects = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) { aspects |= VK_IMAGE_ASPECT_STENCIL_BIT; }
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = depthFormat;
+        imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthImages[i] = allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImageAllocations[i]);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = depthImages[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange.aspectMask = aspects;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthImageViews[i]), "failed to create depth image view!");
+    }
+}
+
 void VulkanApp::createDescriptorSetLayout() {
+    TRACE_SCOPE("createDescriptorSetLayout");
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
     VkDescriptorSetLayoutBinding lightingLayoutBinding{};
     lightingLayoutBinding.binding = 1;
-    lightingLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    lightingLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     lightingLayoutBinding.descriptorCount = 1;
     lightingLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     lightingLayoutBinding.pImmutableSamplers = nullptr;
@@ -458,10 +817,8 @@ std::vector<char> VulkanApp::readFile(const std::string& filename) {
 }
 
 void VulkanApp::createGraphicsPipeline() {
-    // Load shader code
-    auto vertShaderCode = readFile("shader.vert.spv");
-    auto fragShaderCode = readFile("shader.frag.spv");
-
+    TRACE_SCOPE("createGraphicsPipeline");
+    // Shader code was read by loadShaderCode(), possibly while the device was still being created
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
@@ -482,12 +839,16 @@ void VulkanApp::createGraphicsPipeline() {
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    bool packed = cubeMesh.vertexFormat == VertexFormat::Packed;
+    auto bindingDescriptions = cubeMesh.getBindingDescriptions();
+    auto attributeDescriptions = cubeMesh.getAttributeDescriptions();
+    auto instanceAttributes = InstanceData::getAttributeDescriptions();
+    bindingDescriptions.push_back(InstanceData::getBindingDescription());
+    attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
 
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -523,6 +884,15 @@ void VulkanApp::createGraphicsPipeline() {
     rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
 
+    // With a prepass, depth is final before the color pass: only the frontmost fragment passes EQUAL
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = config.depthPrepass ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = config.depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
@@ -548,6 +918,16 @@ void VulkanApp::createGraphicsPipeline() {
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
+    // Packed positions are expanded with the mesh bounds
+    VkPushConstantRange boundsRange{};
+    boundsRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    boundsRange.offset = 0;
+    boundsRange.size = sizeof(MeshBoundsPushConstants);
+    if (packed) {
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &boundsRange;
+    }
+
     if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) { throw std::runtime_error("failed to create pipeline layout!"); }
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
@@ -559,6 +939,7 @@ void VulkanApp::createGraphicsPipeline() {
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipelineLayout;
@@ -568,22 +949,110 @@ void VulkanApp::createGraphicsPipeline() {
 
     if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) { throw std::runtime_error("failed to create graphics pipeline!"); }
 
+    if (config.depthPrepass) {
+        // Same state, but positions only, no fragment shader and no color writes
+        VkShaderModule depthShaderModule = createShaderModule(depthVertShaderCode);
+        VkPipelineShaderStageCreateInfo depthStageInfo = vertShaderStageInfo;
+        depthStageInfo.module = depthShaderModule;
+
+        auto positionBindings = cubeMesh.getPositionBindingDescriptions();
+        auto positionAttributes = cubeMesh.getPositionAttributeDescriptions();
+        // The instance transform but not the material
+        positionBindings.push_back(InstanceData::getBindingDescription());
+        positionAttributes.insert(positionAttributes.end(), instanceAttributes.begin(), instanceAttributes.begin() + InstanceData::MODEL_ATTRIBUTE_COUNT);
+        VkPipelineVertexInputStateCreateInfo positionInputInfo = vertexInputInfo;
+        positionInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(positionBindings.size());
+        positionInputInfo.pVertexBindingDescriptions = positionBindings.data();
+        positionInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(positionAttributes.size());
+        positionInputInfo.pVertexAttributeDescriptions = positionAttributes.data();
+
+        VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = depthStencil;
+        prepassDepthStencil.depthWriteEnable = VK_TRUE;
+        prepassDepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        VkPipelineColorBlendAttachmentState noColorAttachment = colorBlendAttachment;
+        noColorAttachment.colorWriteMask = 0;
+        VkPipelineColorBlendStateCreateInfo noColorBlending = colorBlending;
+        noColorBlending.pAttachments = &noColorAttachment;
+
+        VkGraphicsPipelineCreateInfo prepassInfo = pipelineInfo;
+        prepassInfo.stageCount = 1;
+        prepassInfo.pStages = &depthStageInfo;
+        prepassInfo.pVertexInputState = &positionInputInfo;
+        prepassInfo.pDepthStencilState = &prepassDepthStencil;
+        prepassInfo.pColorBlendState = &noColorBlending;
+        VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &prepassInfo, nullptr, &depthPrepassPipeline),
+                 "failed to create depth prepass pipeline!");
+
+        vkDestroyShaderModule(device, depthShaderModule, nullptr);
+        depthVertShaderCode = std::vector<char>();
+    }
+
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    vertShaderCode = std::vector<char>();
+    fragShaderCode = std::vector<char>();
+}
+
+void VulkanApp::createCullPipeline() {
+    TRACE_SCOPE("createCullPipeline");
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout), "failed to create cull descriptor set layout!");
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout), "failed to create cull pipeline layout!");
+
+    VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline), "failed to create cull pipeline!");
+
+    vkDestroyShaderModule(device, cullShaderModule, nullptr);
+    cullShaderCode = std::vector<char>();
+}
+
+void VulkanApp::loadShaderCode() {
+    TRACE_SCOPE("loadShaderCode");
+    // The packed variant is the same shader compiled with PACKED_VERTICES
+    vertShaderCode = readFile(config.packedVertices ? "shader_packed.vert.spv" : "shader.vert.spv");
+    fragShaderCode = readFile("shader.frag.spv");
+    if (config.depthPrepass) { depthVertShaderCode = readFile(config.packedVertices ? "depth_packed.vert.spv" : "depth.vert.spv"); }
+    if (config.gpuCulling) { cullShaderCode = readFile("cull.comp.spv"); }
 }
 
 void VulkanApp::createFramebuffers() {
+    TRACE_SCOPE("createFramebuffers");
     swapChainFramebuffers.resize(swapChainImageViews.size());
 
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         VkImageView attachments[] = {
-            swapChainImageViews[i]
+            swapChainImageViews[i],
+            depthImageViews[i]
         };
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.attachmentCount = 2;
         framebufferInfo.pAttachments = attachments;
         framebufferInfo.width = swapChainExtent.width;
         framebufferInfo.height = swapChainExtent.height;
@@ -594,6 +1063,7 @@ void VulkanApp::createFramebuffers() {
 }
 
 void VulkanApp::createCommandPool() {
+    TRACE_SCOPE("createCommandPool");
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
     VkCommandPoolCreateInfo poolInfo{};
@@ -604,119 +1074,383 @@ void VulkanApp::createCommandPool() {
     if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) { throw std::runtime_error("failed to create command pool!"); }
 }
 
-void VulkanApp::createCubeMesh() {
-    cubeMesh = MeshGenerator::generateCube(1.0f, 1.0f, 1.0f);
-    cubeMesh.createVertexBuffer(physicalDevice, device, graphicsQueue, commandPool);
-    cubeMesh.createIndexBuffer(physicalDevice, device, graphicsQueue, commandPool);
+void VulkanApp::createUploadManager() {
+    TRACE_SCOPE("createUploadManager");
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    uint32_t graphicsFamily = indices.graphicsFamily.value();
+    if (indices.transferFamily.has_value()) {
+        uploadManager.init(allocator, device, transferQueue, indices.transferFamily.value(), graphicsFamily, STAGING_RING_SIZE);
+    } else {
+        uploadManager.init(allocator, device, graphicsQueue, graphicsFamily, graphicsFamily, STAGING_RING_SIZE);
+    }
 }
 
-void VulkanApp::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-    VkDeviceSize lightingBufferSize = sizeof(LightingBufferObject);
+Mesh VulkanApp::generateShape() const {
+    uint32_t segments = config.meshSegments;
+    switch (config.meshShape) {
+        case MeshShape::Cube: return MeshGenerator::generateCube(1.0f, 1.0f, 1.0f);
+        case MeshShape::Grid: return MeshGenerator::generate(GridShape{1.0f, 1.0f, segments, segments});
+        case MeshShape::UvSphere: return MeshGenerator::generate(UvSphereShape{0.5f, std::max(2u, segments / 2), segments});
+        case MeshShape::IcoSphere: return MeshGenerator::generate(IcoSphereShape{0.5f, segments});
+        case MeshShape::Torus: return MeshGenerator::generate(TorusShape{0.35f, 0.15f, segments, std::max(3u, segments / 2)});
+        case MeshShape::Cylinder: return MeshGenerator::generate(CylinderShape{0.4f, 0.8f, segments, std::max(1u, segments / 4), true});
+    }
+    throw std::runtime_error("unknown mesh shape!");
+}
 
-    uniformBuffers.resize(swapChainImages.size());
-    uniformBuffersMemory.resize(swapChainImages.size());
-    lightingBuffers.resize(swapChainImages.size());
-    lightingBuffersMemory.resize(swapChainImages.size());
+Mesh VulkanApp::loadMeshFile() const {
+    Mesh mesh = MeshLoader::load(config.meshFile);
+    if (mesh.indices.empty()) { throw std::runtime_error("mesh file contains no triangles: " + config.meshFile); }
+
+    // Center the asset and scale its largest side to 1, the size the fixed camera frames
+    mesh.computeBounds();
+    glm::vec3 center = mesh.boundsMin + mesh.boundsExtent * 0.5f;
+    float largestSide = std::max(mesh.boundsExtent.x, std::max(mesh.boundsExtent.y, mesh.boundsExtent.z));
+    float scale = largestSide > 0.0f ? 1.0f / largestSide : 1.0f;
+    for (Vertex& vertex : mesh.vertices) { vertex.position = (vertex.position - center) * scale; }
+    return mesh;
+}
 
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        // Create uniform buffer
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = bufferSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+uint32_t VulkanApp::meshCacheOptions() const {
+    // Every option that changes the uploaded bytes or tables; a cache built with other options is stale
+    uint32_t options = 0;
+    if (config.optimizeMeshes) { options |= 1u << 0; }
+    if (config.buildLods) { options |= 1u << 1; }
+    if (config.meshletCulling) { options |= 1u << 2; }
+    if (config.packedVertices) { options |= 1u << 3; }
+    if (config.splitVertexStreams) { options |= 1u << 4; }
+    // The weld tolerance is a key field of its own
+    if (config.weldVertices) { options |= 1u << 5; }
+    return options;
+}
+
+void VulkanApp::generateCubeMesh() {
+    TRACE_SCOPE("generateCubeMesh");
+    auto generateStart = BenchmarkClock::now();
+
+    // Imported meshes are processed once; later runs upload straight from the mapped cache
+    bool useCache = config.meshCache && !config.meshFile.empty();
+    std::string cachePath = config.meshFile + ".meshcache";
+    MeshCacheKey cacheKey;
+    if (useCache) {
+        cacheKey = MeshCache::makeKey(config.meshFile, meshCacheOptions(), config.weldVertices ? config.weldEpsilon : 0.0f);
+        if (MeshCache::load(cachePath, cacheKey, cubeMesh)) {
+            std::cout << "  Mapped mesh cache " << cachePath << ": " << cubeMesh.indexCount / 3 << " triangles, "
+                      << cubeMesh.lods.size() << " LODs, " << cubeMesh.meshlets.size() << " meshlets in "
+                      << millisecondsBetween(generateStart, BenchmarkClock::now()) << " ms\n";
+            return;
+        }
+    }
+
+    cubeMesh = config.meshFile.empty() ? generateShape() : loadMeshFile();
+    std::cout << "  " << (config.meshFile.empty() ? "Generated" : "Loaded") << " mesh: " << cubeMesh.vertices.size() << " vertices, "
+              << cubeMesh.indices.size() / 3 << " triangles in " << millisecondsBetween(generateStart, BenchmarkClock::now()) << " ms\n";
+    if (config.weldVertices) {
+        WeldTolerance tolerance;
+        tolerance.position = config.weldEpsilon;
+        WeldStats weld = MeshWelder::weld(cubeMesh, tolerance);
+        std::cout << "  Vertex welding (epsilon " << config.weldEpsilon << "): " << weld.verticesBefore << " -> " << weld.verticesAfter
+                  << " vertices, ratio " << weld.compressionRatio() << ", " << weld.degenerateTriangles << " degenerate triangles removed\n";
+    }
+    if (config.optimizeMeshes) {
+        VertexCacheStats before = MeshOptimizer::analyzeVertexCache(cubeMesh.indices, cubeMesh.vertices.size());
+        MeshOptimizer::optimize(cubeMesh);
+        VertexCacheStats after = MeshOptimizer::analyzeVertexCache(cubeMesh.indices, cubeMesh.vertices.size());
+        std::cout << "  Mesh optimization (FIFO " << MeshOptimizer::SIMULATED_CACHE_SIZE << "): ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+    }
+    cubeMesh.computeBounds();
+    if (config.buildLods) {
+        MeshSimplifier::buildLodChain(cubeMesh);
+        std::cout << "  LOD chain:";
+        for (const MeshLod& lod : cubeMesh.lods) { std::cout << " " << lod.indexCount / 3 << " tris (error " << lod.error << ")"; }
+        std::cout << "\n";
+    }
+    if (config.meshletCulling) {
+        MeshletBuilder::buildForMesh(cubeMesh);
+        std::cout << "  Meshlets: " << cubeMesh.meshlets.size() << " (at most " << MeshletBuilder::MAX_VERTICES << " vertices, "
+                  << MeshletBuilder::MAX_TRIANGLES << " triangles)\n";
+    }
+    if (config.splitVertexStreams) { cubeMesh.splitStreams(); }
+    if (config.packedVertices) {
+        cubeMesh.quantize();
+        QuantizationError error = cubeMesh.measureQuantizationError();
+        std::cout << "  Packed vertices: " << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes, max error position "
+                  << error.position << ", normal " << error.normalDegrees << " deg, uv " << error.texCoord << "\n";
+
+        // Rounding to unorm16 loses at most half a step per axis
+        float positionBound = 0.5f / 65535.0f * glm::length(cubeMesh.boundsExtent) * 1.01f;
+        if (error.position > positionBound || error.normalDegrees > MAX_NORMAL_QUANTIZATION_DEGREES) {
+            throw std::runtime_error("vertex quantization error exceeds its bound!");
+        }
+    }
 
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &uniformBuffers[i]) != VK_SUCCESS) { throw std::runtime_error("failed to create uniform buffer!"); }
+    if (useCache) {
+        // A failed write only costs the next run its shortcut
+        try {
+            MeshCache::save(cachePath, cacheKey, cubeMesh);
+            std::cout << "  Wrote mesh cache " << cachePath << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: " << e.what() << std::endl;
+        }
+    }
+}
+
+void VulkanApp::createCubeMesh() {
+    TRACE_SCOPE("createCubeMesh");
+    cubeMesh.createVertexBuffer(allocator, uploadManager);
+    cubeMesh.createIndexBuffer(allocator, uploadManager);
+    // The uploads copied the cached bytes into staging, so the mapping is no longer needed
+    cubeMesh.releaseCachedData();
+    uploadManager.flush();
+}
+
+void VulkanApp::createUniformRing() {
+    TRACE_SCOPE("createUniformRing");
+    // One region per swapchain image: each image's prerecorded command buffer reads its own region
+    uniformRing.init(allocator, physicalDevice, UNIFORM_RING_REGION_SIZE, static_cast<uint32_t>(swapChainImages.size()));
+}
+
+void VulkanApp::createMeshletCommandBuffer() {
+    TRACE_SCOPE("createMeshletCommandBuffer");
+    // Host visible and coherent: the commands are written by the CPU right before each submit
+    meshletCommandRegions = static_cast<uint32_t>(swapChainImages.size());
+    VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(cubeMesh.meshlets.size(), 1) * meshletCommandRegions;
+    meshletCommandBuffer = allocator.createBuffer(size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, meshletCommandAllocation);
+}
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, uniformBuffers[i], &memRequirements);
+void VulkanApp::createBvhCommandBuffer() {
+    TRACE_SCOPE("createBvhCommandBuffer");
+    // Host visible and coherent like the meshlet commands; zeroed, since commands past the draw count
+    // are executed (with zero instances) when VK_KHR_draw_indirect_count is missing
+    bvhCommandRegions = static_cast<uint32_t>(swapChainImages.size());
+    bvhCommandBuffer = allocator.createBuffer(bvhCommandRegionSize() * bvhCommandRegions, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bvhCommandAllocation);
+    memset(bvhCommandAllocation.mapped, 0, static_cast<size_t>(bvhCommandRegionSize() * bvhCommandRegions));
+    bvhRegionDrawCounts.assign(bvhCommandRegions, 0);
+}
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+VkDeviceSize VulkanApp::bvhCommandRegionSize() const {
+    return BVH_COMMAND_HEADER_SIZE + sizeof(VkDrawIndexedIndirectCommand) * MAX_BVH_DRAW_RANGES;
+}
+
+void VulkanApp::createInstanceBuffer(uint32_t count) {
+    TRACE_SCOPE("createInstanceBuffer");
+    auto buildStart = BenchmarkClock::now();
+    std::vector<InstanceData> instances;
+    instanceScale = InstanceGrid::build(count, instances);
+    drawInstanceCount = count;
+
+    if (config.bvhCulling) {
+        // Upload the instances in BVH order, so every subtree is a contiguous range of them
+        auto bvhStart = BenchmarkClock::now();
+        std::vector<ObjectBounds> bounds(count);
+        glm::vec3 boundsMax = cubeMesh.boundsMin + cubeMesh.boundsExtent;
+        parallelFor(count, 16 * 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) { bounds[i] = ObjectBounds::fromTransform(instances[i].model, cubeMesh.boundsMin, boundsMax); }
+        });
+        instanceBvh.build(bounds);
+        bvhCullTotals = BvhCullStats{};
+        bvhCullFrames = 0;
+
+        std::vector<InstanceData> sorted(count);
+        const std::vector<uint32_t>& order = instanceBvh.getObjectOrder();
+        parallelFor(count, 16 * 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) { sorted[i] = instances[order[i]]; }
+        });
+        instances = std::move(sorted);
+        std::cout << "  Instance BVH: " << instanceBvh.getNodeCount() << " nodes built in "
+                  << millisecondsBetween(bvhStart, BenchmarkClock::now()) << " ms\n";
+    }
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &uniformBuffersMemory[i]) != VK_SUCCESS) { throw std::runtime_error("failed to allocate uniform buffer memory!"); }
+    VkDeviceSize size = sizeof(InstanceData) * instances.size();
+    if (config.animateInstances) {
+        animatedInstances = std::move(instances);
+        createAnimatedInstanceBuffer();
+    } else {
+        // With GPU culling the instances are only read by the cull pass, which copies the visible ones out
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                   | (config.gpuCulling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        instanceBuffer = allocator.createBuffer(size, usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instanceAllocation, AllocationPool::General, uploadManager.getQueueFamilies());
+        uploadManager.uploadBuffer(instanceBuffer, 0, instances.data(), size);
+        uploadManager.flush();
+    }
+    buildScene();
+    if (count > 1) {
+        std::cout << "  Instances: " << count << " (" << static_cast<double>(size) / (1024.0 * 1024.0) << " MiB) built in "
+                  << millisecondsBetween(buildStart, BenchmarkClock::now()) << " ms\n";
+    }
+}
 
-        vkBindBufferMemory(device, uniformBuffers[i], uniformBuffersMemory[i], 0);
+void VulkanApp::createAnimatedInstanceBuffer() {
+    TRACE_SCOPE("createAnimatedInstanceBuffer");
+    // Host visible and coherent like the indirect commands: each frame writes its image's region
+    instanceRegions = static_cast<uint32_t>(swapChainImages.size());
+    VkDeviceSize regionSize = sizeof(InstanceData) * animatedInstances.size();
+    instanceBuffer = allocator.createBuffer(regionSize * instanceRegions, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceAllocation);
+    // Materials never change, so later frames only rewrite the transforms
+    for (uint32_t region = 0; region < instanceRegions; region++) {
+        memcpy(static_cast<char*>(instanceAllocation.mapped) + regionSize * region, animatedInstances.data(), static_cast<size_t>(regionSize));
+    }
+}
 
-        // Create lighting buffer
-        bufferInfo.size = lightingBufferSize;
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &lightingBuffers[i]) != VK_SUCCESS) { throw std::runtime_error("failed to create lighting buffer!"); }
+void VulkanApp::buildScene() {
+    TRACE_SCOPE("buildScene");
+    scene.clear();
+    instanceNodes.clear();
+    spinNode = scene.addNode(Scene::NO_PARENT, glm::mat4(1.0f));
+    if (config.animateInstances) {
+        // The shaders apply the spin (ubo.model) after the instance transform, so instances hang off a
+        // root of their own. Their normals come from the upper 3x3 of the transform in the shader.
+        SceneNode instanceRoot = scene.addNode(Scene::NO_PARENT, glm::mat4(1.0f), false);
+        instanceNodes.resize(animatedInstances.size());
+        for (size_t i = 0; i < animatedInstances.size(); i++) {
+            instanceNodes[i] = scene.addNode(instanceRoot, animatedInstances[i].model, false);
+        }
+        if (config.bvhCulling) { animatedBounds.resize(animatedInstances.size()); }
+    }
+    scene.update();
+}
 
-        vkGetBufferMemoryRequirements(device, lightingBuffers[i], &memRequirements);
+void VulkanApp::createCullBuffers() {
+    TRACE_SCOPE("createCullBuffers");
+    // Both are only touched by the GPU: the cull pass writes them and the draws read them
+    visibleInstanceBuffer = allocator.createBuffer(sizeof(InstanceData) * drawInstanceCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        visibleInstanceAllocation);
+    drawCommandBuffer = allocator.createBuffer(sizeof(GpuDrawCommands),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandAllocation);
+    writeCullDescriptorSet();
+}
 
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+void VulkanApp::writeCullDescriptorSet() {
+    std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0] = {uniformRing.getBuffer(), 0, sizeof(CullBufferObject)};
+    bufferInfos[1] = {instanceBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[2] = {visibleInstanceBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[3] = {drawCommandBuffer, 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = cullDescriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &lightingBuffersMemory[i]) != VK_SUCCESS) { throw std::runtime_error("failed to allocate lighting buffer memory!"); }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
 
-        vkBindBufferMemory(device, lightingBuffers[i], lightingBuffersMemory[i], 0);
+void VulkanApp::setInstanceCount(uint32_t count) {
+    if (count == drawInstanceCount) { return; }
+    // Only done between benchmark steps, so a full stall is acceptable
+    vkDeviceWaitIdle(device);
+    allocator.destroyBuffer(instanceBuffer, instanceAllocation);
+    createInstanceBuffer(count);
+    if (config.gpuCulling) {
+        allocator.destroyBuffer(visibleInstanceBuffer, visibleInstanceAllocation);
+        allocator.destroyBuffer(drawCommandBuffer, drawCommandAllocation);
+        createCullBuffers();
     }
+    uploadManager.waitIdle();
+
+    if (!commandBuffers.empty()) { vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data()); }
+    createCommandBuffers();
+}
+
+VulkanApp::FrameUniforms VulkanApp::allocateFrameUniforms(uint32_t imageIndex) {
+    // Called both when recording and when updating, so the order here fixes the dynamic offsets
+    uniformRing.beginFrame(imageIndex);
+    FrameUniforms uniforms;
+    uniforms.transforms = uniformRing.allocate(sizeof(UniformBufferObject));
+    uniforms.lighting = uniformRing.allocate(sizeof(LightingBufferObject));
+    if (config.gpuCulling) { uniforms.cull = uniformRing.allocate(sizeof(CullBufferObject)); }
+    return uniforms;
 }
 
 void VulkanApp::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
+    TRACE_SCOPE("createDescriptorPool");
+    // A single set: the uniform ring's dynamic offsets pick the per-frame data. GPU culling adds its own.
+    std::vector<VkDescriptorPoolSize> poolSizes(1);
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = config.gpuCulling ? 3 : 2;
+    if (config.gpuCulling) { poolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3}); }
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size()) * 2;
+    poolInfo.maxSets = config.gpuCulling ? 2 : 1;
 
     if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) { throw std::runtime_error("failed to create descriptor pool!"); }
 }
-
 void VulkanApp::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
+    TRACE_SCOPE("createDescriptorSets");
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-    allocInfo.pSetLayouts = layouts.data();
-
-    descriptorSets.resize(swapChainImages.size());
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) { throw std::runtime_error("failed to allocate descriptor sets!"); }
-
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkDescriptorBufferInfo lightingBufferInfo{};
-        lightingBufferInfo.buffer = lightingBuffers[i];
-        lightingBufferInfo.offset = 0;
-        lightingBufferInfo.range = sizeof(LightingBufferObject);
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pBufferInfo = &lightingBufferInfo;
-
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) { throw std::runtime_error("failed to allocate descriptor sets!"); }
+    if (config.gpuCulling) {
+        // Written by writeCullDescriptorSet() once the cull buffers exist
+        allocInfo.pSetLayouts = &cullDescriptorSetLayout;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &cullDescriptorSet), "failed to allocate cull descriptor set!");
     }
-}
 
+    // Both bindings view the ring at offset 0; the dynamic offsets bound per draw select the frame's slices
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = uniformRing.getBuffer();
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
+
+    VkDescriptorBufferInfo lightingBufferInfo{};
+    lightingBufferInfo.buffer = uniformRing.getBuffer();
+    lightingBufferInfo.offset = 0;
+    lightingBufferInfo.range = sizeof(LightingBufferObject);
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = descriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = descriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pBufferInfo = &lightingBufferInfo;
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
 void VulkanApp::createCommandBuffers() {
+    TRACE_SCOPE("createCommandBuffers");
+    // Level of detail from the projected error at the closest point of the mesh's bounding sphere. The
+    // camera and mesh center do not move, so the choice only changes with the render target height.
+    glm::vec3 meshCenter = cubeMesh.boundsMin + cubeMesh.boundsExtent * 0.5f;
+    float meshRadius = glm::length(cubeMesh.boundsExtent) * 0.5f;
+    float distance = std::max(glm::length(cameraPos - meshCenter) - meshRadius, 0.001f);
+    float pixelsPerUnit = static_cast<float>(swapChainExtent.height) / (2.0f * distance * std::tan(glm::radians(CAMERA_FOV_DEGREES) * 0.5f));
+    // Instances shrink the mesh, and its errors with it
+    drawLod = cubeMesh.selectLod(pixelsPerUnit * instanceScale, config.lodPixelError);
+
+    // Recorded by recordFrame() instead
+    if (config.perFrameRecording) { return; }
+
     commandBuffers.resize(swapChainFramebuffers.size());
 
     VkCommandBufferAllocateInfo allocInfo{};
@@ -733,64 +1467,288 @@ void VulkanApp::createCommandBuffers() {
 
         if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) { throw std::runtime_error("failed to begin recording command buffer!"); }
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[i];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        uint32_t slot = static_cast<uint32_t>(i);
+        gpuProfiler.beginFrame(commandBuffers[i], slot);
+        FrameUniforms uniforms = allocateFrameUniforms(slot);
+        if (config.gpuCulling) { recordCulling(commandBuffers[i], slot, uniforms.cull.offset); }
+        uint32_t renderPassScope = gpuProfiler.beginScope(commandBuffers[i], slot, "render pass");
+
+        beginRenderPass(commandBuffers[i], i, VK_SUBPASS_CONTENTS_INLINE);
+        recordDrawState(commandBuffers[i], i, uniforms);
+
+        // Both pipelines share the layout, so the bindings above serve the prepass and the color pass
+        if (config.depthPrepass) {
+            uint32_t prepassScope = gpuProfiler.beginScope(commandBuffers[i], slot, "depth prepass");
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+            recordMeshDraw(commandBuffers[i], i);
+            gpuProfiler.endScope(commandBuffers[i], slot, prepassScope);
+        }
+
+        uint32_t drawScope = gpuProfiler.beginScope(commandBuffers[i], slot, "draw cube");
+        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        recordMeshDraw(commandBuffers[i], i);
+        gpuProfiler.endScope(commandBuffers[i], slot, drawScope);
+
+        vkCmdEndRenderPass(commandBuffers[i]);
 
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+        gpuProfiler.endScope(commandBuffers[i], slot, renderPassScope);
 
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) { throw std::runtime_error("failed to record command buffer!"); }
+    }
+}
 
-        // Bind pipeline and draw
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+void VulkanApp::createFrameRecorders() {
+    TRACE_SCOPE("createFrameRecorders");
+    uint32_t workerCount = config.recordThreads;
+    if (workerCount == 0) { workerCount = std::max(1u, std::thread::hardware_concurrency()); }
+    // Woken every frame rather than created per frame; worker i always runs on the same thread
+    frameWorkers.start(workerCount);
 
-        // Set dynamic viewport and scissor
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)width;
-        viewport.height = (float)height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
+    // Transient: every buffer is reset with its pool each time the frame comes around
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = findQueueFamilies(physicalDevice).graphicsFamily.value();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent.width = width;
-        scissor.extent.height = height;
-        vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 
-        VkBuffer vertexBuffers[] = {cubeMesh.vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+    frameRecorders.resize(MAX_FRAMES_IN_FLIGHT);
+    for (FrameRecorder& recorder : frameRecorders) {
+        VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &recorder.primaryPool), "failed to create command pool!");
+        allocInfo.commandPool = recorder.primaryPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &recorder.primary), "failed to allocate command buffers!");
+
+        recorder.workers.resize(workerCount);
+        for (RecordWorker& worker : recorder.workers) {
+            VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &worker.pool), "failed to create command pool!");
+            VkCommandBuffer secondaries[2];
+            allocInfo.commandPool = worker.pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 2;
+            VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, secondaries), "failed to allocate command buffers!");
+            worker.prepass = secondaries[0];
+            worker.color = secondaries[1];
+        }
+        recorder.executed.reserve(workerCount * 2);
+    }
+}
 
-        vkCmdBindIndexBuffer(commandBuffers[i], cubeMesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+void VulkanApp::beginRenderPass(VkCommandBuffer commandBuffer, size_t imageIndex, VkSubpassContents contents) const {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swapChainExtent;
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+}
 
-        vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+void VulkanApp::recordDrawState(VkCommandBuffer commandBuffer, size_t imageIndex, const FrameUniforms& uniforms) const {
+    // Set dynamic viewport and scissor
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapChainExtent.width;
+    viewport.height = (float)swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    cubeMesh.bindVertexBuffers(commandBuffer);
+    VkDeviceSize instanceOffset = config.animateInstances ? sizeof(InstanceData) * drawInstanceCount * imageIndex : 0;
+    VkBuffer drawnInstances = config.gpuCulling ? visibleInstanceBuffer : instanceBuffer;
+    vkCmdBindVertexBuffers(commandBuffer, InstanceData::BINDING, 1, &drawnInstances, &instanceOffset);
+
+    cubeMesh.bindIndexBuffer(commandBuffer);
+
+    uint32_t dynamicOffsets[] = {uniforms.transforms.offset, uniforms.lighting.offset};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 2, dynamicOffsets);
+
+    if (cubeMesh.vertexFormat == VertexFormat::Packed) {
+        MeshBoundsPushConstants bounds = cubeMesh.getBoundsPushConstants();
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(bounds), &bounds);
+    }
+}
 
-        vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(cubeMesh.indices.size()), 1, 0, 0, 0);
+void VulkanApp::recordCulling(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t cullOffset) {
+    uint32_t cullScope = gpuProfiler.beginScope(commandBuffer, slot, "gpu cull");
+
+    // The buffers are shared by all images: the previous frame's draws must be done reading them (an
+    // execution dependency covers write-after-read)
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    // Reset the command to the level baked into this command buffer with no instances; the shader counts them
+    GpuDrawCommands commands{};
+    commands.command.indexCount = drawLod.indexCount;
+    commands.command.firstIndex = drawLod.firstIndex;
+    vkCmdUpdateBuffer(commandBuffer, drawCommandBuffer, 0, sizeof(commands), &commands);
+
+    VkMemoryBarrier resetBarrier{};
+    resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSet, 1, &cullOffset);
+    vkCmdDispatch(commandBuffer, (drawInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    gpuProfiler.endScope(commandBuffer, slot, cullScope);
+}
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+void VulkanApp::recordMeshDraw(VkCommandBuffer commandBuffer, size_t imageIndex) const {
+    if (config.gpuCulling) {
+        VkDeviceSize commandOffset = offsetof(GpuDrawCommands, command);
+        if (cmdDrawIndexedIndirectCount != nullptr) {
+            cmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer, commandOffset, drawCommandBuffer,
+                                        offsetof(GpuDrawCommands, drawCount), 1, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            // Issued even when everything was culled, but then with zero instances
+            vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, commandOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    } else if (config.bvhCulling) {
+        // The region's draw count limits the commands when the extension is there; otherwise the ones past
+        // it have zero instances
+        VkDeviceSize regionOffset = bvhCommandRegionSize() * imageIndex;
+        VkDeviceSize commandsOffset = regionOffset + BVH_COMMAND_HEADER_SIZE;
+        if (cmdDrawIndexedIndirectCount != nullptr) {
+            cmdDrawIndexedIndirectCount(commandBuffer, bvhCommandBuffer, commandsOffset, bvhCommandBuffer, regionOffset,
+                                        MAX_BVH_DRAW_RANGES, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            for (uint32_t first = 0; first < MAX_BVH_DRAW_RANGES; first += maxDrawIndirectCount) {
+                uint32_t count = std::min(MAX_BVH_DRAW_RANGES - first, maxDrawIndirectCount);
+                VkDeviceSize offset = commandsOffset + sizeof(VkDrawIndexedIndirectCommand) * first;
+                vkCmdDrawIndexedIndirect(commandBuffer, bvhCommandBuffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    } else if (config.meshletCulling) {
+        // One command per meshlet of the level; culled ones are zeroed out per frame, not removed
+        VkDeviceSize regionOffset = sizeof(VkDrawIndexedIndirectCommand) * cubeMesh.meshlets.size() * imageIndex;
+        for (uint32_t first = 0; first < drawLod.meshletCount; first += maxDrawIndirectCount) {
+            uint32_t count = std::min(drawLod.meshletCount - first, maxDrawIndirectCount);
+            VkDeviceSize offset = regionOffset + sizeof(VkDrawIndexedIndirectCommand) * (drawLod.firstMeshlet + first);
+            vkCmdDrawIndexedIndirect(commandBuffer, meshletCommandBuffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    } else {
+        vkCmdDrawIndexed(commandBuffer, drawLod.indexCount, drawInstanceCount, drawLod.firstIndex, 0, 0);
+    }
+}
 
-        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) { throw std::runtime_error("failed to record command buffer!"); }
+VkCommandBuffer VulkanApp::recordFrame(uint32_t imageIndex) {
+    TRACE_SCOPE("recordFrame");
+    auto recordStart = BenchmarkClock::now();
+    // This frame's fence has signaled, so nothing allocated from its pools is still executing
+    FrameRecorder& recorder = frameRecorders[currentFrame];
+    VK_CHECK(vkResetCommandPool(device, recorder.primaryPool, 0), "failed to reset command pool!");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(recorder.primary, &beginInfo), "failed to begin recording command buffer!");
+
+    gpuProfiler.beginFrame(recorder.primary, imageIndex);
+    FrameUniforms uniforms = allocateFrameUniforms(imageIndex);
+    if (config.gpuCulling) { recordCulling(recorder.primary, imageIndex, uniforms.cull.offset); }
+    uint32_t renderPassScope = gpuProfiler.beginScope(recorder.primary, imageIndex, "render pass");
+
+    // The draw list is the visible BVH ranges, otherwise the single (possibly indirect) mesh draw. Each
+    // worker records a contiguous slice of it into its own pool; short lists stay on fewer threads.
+    uint32_t drawCount = config.bvhCulling ? static_cast<uint32_t>(visibleRanges.size()) : 1;
+    uint32_t workerCount = std::min(static_cast<uint32_t>(recorder.workers.size()),
+                                    std::max(1u, drawCount / MIN_DRAWS_PER_RECORD_THREAD));
+    frameWorkers.run(workerCount, [&](uint32_t worker) {
+        uint32_t firstDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * worker / workerCount);
+        uint32_t endDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (worker + 1) / workerCount);
+        recordSecondaries(recorder.workers[worker], imageIndex, uniforms, firstDraw, endDraw);
+    });
+
+    // All prepass secondaries run before any color one, so the color pass sees the complete depth
+    recorder.executed.clear();
+    if (config.depthPrepass) {
+        for (uint32_t worker = 0; worker < workerCount; worker++) { recorder.executed.push_back(recorder.workers[worker].prepass); }
     }
+    for (uint32_t worker = 0; worker < workerCount; worker++) { recorder.executed.push_back(recorder.workers[worker].color); }
+
+    // Only vkCmdExecuteCommands is allowed inside the pass, so the draws get no timestamp scopes of their own
+    beginRenderPass(recorder.primary, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(recorder.primary, static_cast<uint32_t>(recorder.executed.size()), recorder.executed.data());
+    vkCmdEndRenderPass(recorder.primary);
+
+    gpuProfiler.endScope(recorder.primary, imageIndex, renderPassScope);
+
+    VK_CHECK(vkEndCommandBuffer(recorder.primary), "failed to record command buffer!");
+    frameTimings.recordMs = millisecondsBetween(recordStart, BenchmarkClock::now());
+    return recorder.primary;
+}
+
+void VulkanApp::recordSecondaries(RecordWorker& worker, uint32_t imageIndex, const FrameUniforms& uniforms,
+                                  uint32_t firstDraw, uint32_t endDraw) const {
+    TRACE_SCOPE("recordSecondaries");
+    VK_CHECK(vkResetCommandPool(device, worker.pool, 0), "failed to reset command pool!");
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    // Secondaries inherit no state from the primary, so each binds everything it draws with
+    auto record = [&](VkCommandBuffer commandBuffer, VkPipeline pipeline) {
+        VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo), "failed to begin recording command buffer!");
+        recordDrawState(commandBuffer, imageIndex, uniforms);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (config.bvhCulling) {
+            // Recorded fresh every frame, so the visible ranges become direct draws
+            for (uint32_t i = firstDraw; i < endDraw; i++) {
+                vkCmdDrawIndexed(commandBuffer, drawLod.indexCount, visibleRanges[i].count, drawLod.firstIndex, 0, visibleRanges[i].first);
+            }
+        } else {
+            recordMeshDraw(commandBuffer, imageIndex);
+        }
+        VK_CHECK(vkEndCommandBuffer(commandBuffer), "failed to record command buffer!");
+    };
+    if (config.depthPrepass) { record(worker.prepass, depthPrepassPipeline); }
+    record(worker.color, graphicsPipeline);
 }
 
 void VulkanApp::createSyncObjects() {
-    // Create per-frame fences (for CPU-GPU synchronization)
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    
-    // Create per-image semaphores (for proper swapchain synchronization)
-    imageAvailableSemaphores.resize(swapChainImages.size());
-    renderFinishedSemaphores.resize(swapChainImages.size());
+    TRACE_SCOPE("createSyncObjects");
+    // Create per-image semaphores (for proper swapchain synchronization, not needed without presentation)
+    size_t semaphoreCount = config.headless ? 0 : swapChainImages.size();
+    imageAvailableSemaphores.resize(semaphoreCount);
+    renderFinishedSemaphores.resize(semaphoreCount);
+    // Entries survive swapchain recreation: image i still shares uniform region and profiler slot i with
+    // whatever frame is in flight for the old image i
+    imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -799,31 +1757,66 @@ void VulkanApp::createSyncObjects() {
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    // Create per-frame fences
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]));
+    // Create per-frame fences once; they outlive swapchain recreation
+    if (inFlightFences.empty()) {
+        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        inFlightFrameNumbers.assign(MAX_FRAMES_IN_FLIGHT, 0);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]));
+        }
     }
     
     // Create per-image semaphores
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
+    for (size_t i = 0; i < semaphoreCount; i++) {
         VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]));
         VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]));
     }
 }
 
-void VulkanApp::drawFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+bool VulkanApp::drawFrame() {
+    TRACE_SCOPE("drawFrame");
+    auto drawStart = BenchmarkClock::now();
+    frameTimings = FrameTimings{};
+
+    {
+        TRACE_SCOPE("vkWaitForFences");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    // Frames finish in submission order, so everything up to this fence's frame is done
+    deletionQueue.collect(inFlightFrameNumbers[currentFrame]);
+    auto fenceSignaled = BenchmarkClock::now();
+    frameTimings.fenceWaitMs = millisecondsBetween(drawStart, fenceSignaled);
 
     uint32_t imageIndex;
-    // Use per-frame semaphore for acquire (we don't know imageIndex yet)
-    VkSemaphore imageAvailableSemaphore = imageAvailableSemaphores[currentFrame % swapChainImages.size()];
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+    VkResult result;
+    if (config.headless) {
+        // Offscreen targets are paired with frames in flight, so the fence above already made this one idle
+        imageIndex = static_cast<uint32_t>(currentFrame);
+    } else {
+        // Use per-frame semaphore for acquire (we don't know imageIndex yet)
+        imageAvailableSemaphore = imageAvailableSemaphores[currentFrame % swapChainImages.size()];
+        {
+            TRACE_SCOPE("vkAcquireNextImageKHR");
+            result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        }
+        frameTimings.acquireMs = millisecondsBetween(fenceSignaled, BenchmarkClock::now());
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return;
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+            return false;
+        }
+        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) { throw std::runtime_error("failed to acquire swap chain image!"); }
+    }
+
+    // The image's prerecorded command buffer may still be executing for an earlier frame
+    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE && imagesInFlight[imageIndex] != inFlightFences[currentFrame]) {
+        vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
     }
-    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) { throw std::runtime_error("failed to acquire swap chain image!"); }
+    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+    // The previous submission of this command buffer has completed, so its timestamps are ready
+    gpuProfiler.collect(imageIndex);
 
     // Update uniform buffers
     updateUniformBuffer(imageIndex);
@@ -834,21 +1827,36 @@ void VulkanApp::drawFrame() {
     // Use the same semaphore that was used for acquire
     VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = config.headless ? 0 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
+    VkCommandBuffer frameCommandBuffer = config.perFrameRecording ? recordFrame(imageIndex) : commandBuffers[imageIndex];
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &frameCommandBuffer;
 
     // Use per-image semaphore for signaling (now we know imageIndex)
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex]};
-    submitInfo.signalSemaphoreCount = 1;
+    VkSemaphore signalSemaphores[] = {config.headless ? VK_NULL_HANDLE : renderFinishedSemaphores[imageIndex]};
+    submitInfo.signalSemaphoreCount = config.headless ? 0 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) { throw std::runtime_error("failed to submit draw command buffer!"); }
+    auto submitStart = BenchmarkClock::now();
+    {
+        TRACE_SCOPE("vkQueueSubmit");
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) { throw std::runtime_error("failed to submit draw command buffer!"); }
+    }
+    inFlightFrameNumbers[currentFrame] = ++submittedFrame;
+    auto submitEnd = BenchmarkClock::now();
+    frameTimings.submitMs = millisecondsBetween(submitStart, submitEnd);
+    gpuProfiler.markSubmitted(imageIndex);
+
+    if (config.headless) {
+        frameTimings.cpuMs = millisecondsBetween(fenceSignaled, submitEnd);
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return true;
+    }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -862,7 +1870,15 @@ void VulkanApp::drawFrame() {
 
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        TRACE_SCOPE("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
+    auto presentEnd = BenchmarkClock::now();
+    frameTimings.presentMs = millisecondsBetween(submitEnd, presentEnd);
+    frameTimings.cpuMs = millisecondsBetween(fenceSignaled, presentEnd);
+    // Suboptimal images are still presented; out-of-date ones are dropped
+    bool presented = result != VK_ERROR_OUT_OF_DATE_KHR;
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
         framebufferResized = false;
@@ -871,33 +1887,75 @@ void VulkanApp::drawFrame() {
     else if (result != VK_SUCCESS) { throw std::runtime_error("failed to present swap chain image!"); }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    return presented;
 }
 
 void VulkanApp::updateUniformBuffer(uint32_t currentImage) {
+    TRACE_SCOPE("updateUniformBuffer");
     static auto startTime = std::chrono::high_resolution_clock::now();
 
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+    scene.setLocal(spinNode, glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    if (config.animateInstances) { animateInstances(time); }
+    scene.update(frameWorkers);
+    // Before culling, which needs the refit BVH
+    if (config.animateInstances) { uploadAnimatedInstances(currentImage); }
+
     // Update uniform buffer (matrices)
     UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    ubo.model = scene.getWorld(spinNode);
     ubo.view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-    // Get current window size for correct aspect ratio
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    float aspectRatio = width / (float)height;
+    // Use the current render target size for correct aspect ratio
+    float aspectRatio = swapChainExtent.width / (float)swapChainExtent.height;
     
-    ubo.proj = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 10.0f);
+    ubo.proj = glm::perspective(glm::radians(CAMERA_FOV_DEGREES), aspectRatio, 0.1f, 10.0f);
     ubo.proj[1][1] *= -1; // Flip Y for Vulkan
     
-    // Pre-calculate normal matrix on CPU (much more efficient than GPU per-vertex calculation)
-    ubo.normalMatrix = glm::mat3(glm::transpose(glm::inverse(ubo.model)));
+    // Normal matrix precomputed on the CPU by the scene (much more efficient than GPU per-vertex calculation)
+    ubo.normalMatrix = scene.getNormalMatrix(spinNode);
+
+    FrameUniforms uniforms = allocateFrameUniforms(currentImage);
+    memcpy(uniforms.transforms.data, &ubo, sizeof(ubo));
+
+    // Instance transforms map into the space ubo.model maps out of, so instances are culled there
+    Frustum instanceFrustum = Frustum::fromMatrix(ubo.proj * ubo.view * ubo.model);
+    if (config.gpuCulling) {
+        CullBufferObject cull{};
+        for (int i = 0; i < 6; i++) { cull.planes[i] = instanceFrustum.planes[i]; }
+        cull.boundingSphere = glm::vec4(cubeMesh.boundsMin + cubeMesh.boundsExtent * 0.5f, glm::length(cubeMesh.boundsExtent) * 0.5f);
+        cull.instanceCount = drawInstanceCount;
+        memcpy(uniforms.cull.data, &cull, sizeof(cull));
+    }
 
-    void* data;
-    vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+    if (config.bvhCulling) {
+        bvhCullTotals += instanceBvh.cull(instanceFrustum, visibleRanges, MAX_BVH_DRAW_RANGES);
+        bvhCullFrames++;
+    }
+
+    // Per-frame recording draws the visible ranges directly
+    if (config.bvhCulling && !config.perFrameRecording) {
+        // This image's previous frame has completed, so its region can be rewritten
+        char* region = static_cast<char*>(bvhCommandAllocation.mapped) + bvhCommandRegionSize() * currentImage;
+        auto* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(region + BVH_COMMAND_HEADER_SIZE);
+        uint32_t drawCount = static_cast<uint32_t>(visibleRanges.size());
+        for (uint32_t i = 0; i < drawCount; i++) {
+            commands[i] = {drawLod.indexCount, visibleRanges[i].count, drawLod.firstIndex, 0, visibleRanges[i].first};
+        }
+        uint32_t& previousCount = bvhRegionDrawCounts[currentImage];
+        if (previousCount > drawCount) { memset(commands + drawCount, 0, sizeof(VkDrawIndexedIndirectCommand) * (previousCount - drawCount)); }
+        previousCount = drawCount;
+        memcpy(region, &drawCount, sizeof(drawCount));
+    }
+
+    if (config.meshletCulling) {
+        // This image's previous frame has completed, so its region of commands can be rewritten
+        auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(meshletCommandAllocation.mapped)
+                         + cubeMesh.meshlets.size() * currentImage + drawLod.firstMeshlet;
+        meshletCullTotals += MeshletBuilder::cull(cubeMesh.meshlets.data() + drawLod.firstMeshlet, drawLod.meshletCount,
+                                                  ubo.model, ubo.proj * ubo.view, cameraPos, commands);
+    }
 
     // Update lighting buffer
     LightingBufferObject lightBuffer{};
@@ -907,9 +1965,116 @@ void VulkanApp::updateUniformBuffer(uint32_t currentImage) {
     lightBuffer.ambientStrength = 0.1f;
     lightBuffer.specularStrength = 0.5f;
 
-    vkMapMemory(device, lightingBuffersMemory[currentImage], 0, sizeof(lightBuffer), 0, &data);
-    memcpy(data, &lightBuffer, sizeof(lightBuffer));
-    vkUnmapMemory(device, lightingBuffersMemory[currentImage]);
+    memcpy(uniforms.lighting.data, &lightBuffer, sizeof(lightBuffer));
+}
+
+void VulkanApp::animateInstances(float time) {
+    TRACE_SCOPE("animateInstances");
+    uint32_t count = static_cast<uint32_t>(instanceNodes.size());
+    parallelFor(ParallelTarget{&frameWorkers}, count, 16 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            // 45 to 135 degrees per second, hashed from the instance's position in the buffer
+            float speed = glm::radians(45.0f + 90.0f * static_cast<float>((i * 2654435761u) >> 24) / 255.0f);
+            scene.setLocal(instanceNodes[i], glm::rotate(animatedInstances[i].model, time * speed, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+    });
+}
+
+void VulkanApp::uploadAnimatedInstances(uint32_t currentImage) {
+    TRACE_SCOPE("uploadAnimatedInstances");
+    // This image's previous frame has completed, so its region can be rewritten
+    auto* region = static_cast<InstanceData*>(instanceAllocation.mapped) + animatedInstances.size() * currentImage;
+    const std::vector<uint32_t>& bvhOrder = instanceBvh.getObjectOrder();
+    glm::vec3 boundsMax = cubeMesh.boundsMin + cubeMesh.boundsExtent;
+    uint32_t count = static_cast<uint32_t>(instanceNodes.size());
+    parallelFor(ParallelTarget{&frameWorkers}, count, 16 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const glm::mat4& world = scene.getWorld(instanceNodes[i]);
+            region[i].model = world;
+            // The instances are in BVH order, refit() takes the bounds in build order
+            if (config.bvhCulling) { animatedBounds[bvhOrder[i]] = ObjectBounds::fromTransform(world, cubeMesh.boundsMin, boundsMax); }
+        }
+    });
+    if (config.bvhCulling) { instanceBvh.refit(animatedBounds, frameWorkers); }
+}
+
+void VulkanApp::saveOffscreenImage(uint32_t imageIndex, const std::string& filename) {
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+
+    // Host-visible readback buffer
+    Allocation readbackAllocation;
+    VkBuffer readbackBuffer = allocator.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackAllocation, AllocationPool::Linear);
+
+    // Record the image -> buffer copy
+    VkCommandBufferAllocateInfo allocInfoCmd{};
+    allocInfoCmd.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfoCmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfoCmd.commandPool = commandPool;
+    allocInfoCmd.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocInfoCmd, &commandBuffer), "failed to allocate readback command buffer!");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // The render pass already left the image in TRANSFER_SRC_OPTIMAL; make its color writes visible to the copy
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainImages[imageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE), "failed to submit readback command buffer!");
+    vkQueueWaitIdle(graphicsQueue);
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+    // Write RGBA8 pixels as a binary PPM (RGB)
+    const uint8_t* pixels = static_cast<const uint8_t*>(readbackAllocation.mapped);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) { throw std::runtime_error("failed to open output image: " + filename); }
+
+    file << "P6\n" << swapChainExtent.width << " " << swapChainExtent.height << "\n255\n";
+    std::vector<char> row(static_cast<size_t>(swapChainExtent.width) * 3);
+    for (uint32_t y = 0; y < swapChainExtent.height; y++) {
+        const uint8_t* src = pixels + static_cast<size_t>(y) * swapChainExtent.width * 4;
+        for (uint32_t x = 0; x < swapChainExtent.width; x++) {
+            row[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+            row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+        file.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+
+    allocator.destroyBuffer(readbackBuffer, readbackAllocation);
+
+    std::cout << "Saved frame to " << filename << std::endl;
 }
 
 bool VulkanApp::isDeviceSuitable(VkPhysicalDevice physicalDev) {
@@ -929,14 +2094,23 @@ QueueFamilyIndices VulkanApp::findQueueFamilies(VkPhysicalDevice physicalDev) {
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { indices.graphicsFamily = i; }
+        // A transfer-only family is usually a dedicated DMA engine that copies without stealing graphics time
+        VkQueueFlags computeOrGraphics = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & computeOrGraphics) && !indices.transferFamily.has_value()) {
+            indices.transferFamily = i;
+        }
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDev, i, surface, &presentSupport);
+        // Keep scanning for the transfer family, but stop updating the others once both are found
+        if (!indices.isComplete()) {
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { indices.graphicsFamily = i; }
 
-        if (presentSupport) { indices.presentFamily = i; }
+            // Without a surface nothing is presented; the graphics queue stands in for the present queue
+            VkBool32 presentSupport = false;
+            if (surface != VK_NULL_HANDLE) { vkGetPhysicalDeviceSurfaceSupportKHR(physicalDev, i, surface, &presentSupport); }
+            else { presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0; }
 
-        if (indices.isComplete()) { break; }
+            if (presentSupport) { indices.presentFamily = i; }
+        }
 
         i++;
     }
@@ -996,19 +2170,19 @@ VkSurfaceFormatKHR VulkanApp::chooseSwapSurfaceFormat(const std::vector<VkSurfac
 VkPresentModeKHR VulkanApp::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
     for (const auto& availablePresentMode : availablePresentModes) { if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) { return availablePresentMode; } }
 
+    // A vsync-capped FIFO swapchain would only measure the display refresh rate
+    if (config.benchmark) {
+        for (const auto& availablePresentMode : availablePresentModes) { if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) { return availablePresentMode; } }
+    }
+
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 VkExtent2D VulkanApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
     if (capabilities.currentExtent.width != UINT32_MAX) { return capabilities.currentExtent; }
     else {
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-
-        VkExtent2D actualExtent = {
-            static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height)
-        };
+        // GLFW window queries are main-thread only, so use the size captured there
+        VkExtent2D actualExtent = framebufferExtent;
 
         actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
         actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -1017,6 +2191,39 @@ VkExtent2D VulkanApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilit
     }
 }
 
+VkFormat VulkanApp::findDepthFormat() const {
+    // Every device supports D32_SFLOAT or X8_D24 as a depth attachment; formats with stencil are a last resort
+    for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) { return format; }
+    }
+    throw std::runtime_error("failed to find a supported depth format!");
+}
+
+BenchmarkInfo VulkanApp::describeBenchmark() const {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    BenchmarkInfo info;
+    info.deviceName = properties.deviceName;
+    info.driverVersion = std::to_string(properties.driverVersion);
+    info.mode = config.headless ? "headless" : "windowed";
+    info.width = swapChainExtent.width;
+    info.height = swapChainExtent.height;
+    info.instances = drawInstanceCount;
+
+    for (const auto& timing : gpuProfiler.timings()) { info.gpuScopes.emplace_back(timing.name, timing.averageMs()); }
+
+    if (config.headless) { info.presentMode = "none"; }
+    else if (swapChainPresentMode == VK_PRESENT_MODE_MAILBOX_KHR) { info.presentMode = "mailbox"; }
+    else if (swapChainPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) { info.presentMode = "immediate"; }
+    else if (swapChainPresentMode == VK_PRESENT_MODE_FIFO_KHR) { info.presentMode = "fifo"; }
+    else { info.presentMode = std::to_string(swapChainPresentMode); }
+
+    return info;
+}
+
 VkShaderModule VulkanApp::createShaderModule(const std::vector<char>& code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -1029,15 +2236,6 @@ VkShaderModule VulkanApp::createShaderModule(const std::vector<char>& code) {
     return shaderModule;
 }
 
-uint32_t VulkanApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) { if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) { return i; } }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
-
 void VulkanApp::recreateSwapChain() {
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
@@ -1045,35 +2243,105 @@ void VulkanApp::recreateSwapChain() {
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
     }
-
-    vkDeviceWaitIdle(device);
-
+    framebufferExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+
+    // No vkDeviceWaitIdle: frames in flight keep using the old objects, which the deletion queue
+    // releases once the last frame submitted so far has completed
+    TRACE_SCOPE("recreateSwapChain");
+    // The graphics fences do not cover vkQueuePresentKHR, which still waits on the old render-finished
+    // semaphores. Draining only the present queue is cheap next to a device-wide wait and lets the
+    // deletion queue retire them with the rest.
+    if (!config.headless) { vkQueueWaitIdle(presentQueue); }
     cleanupSwapChain();
 
     createSwapChain();
     createImageViews();
+    createDepthResources();
     createFramebuffers();
+    if (swapChainImages.size() > uniformRing.getRegionCount()) {
+        // More images than ring regions: build a new ring and descriptor set, retiring the old ones
+        UniformRing oldRing = uniformRing;
+        VkDescriptorPool oldPool = descriptorPool;
+        deletionQueue.push(submittedFrame, [this, oldRing, oldPool]() mutable {
+            vkDestroyDescriptorPool(device, oldPool, nullptr);
+            oldRing.cleanup(allocator);
+        });
+        createUniformRing();
+        createDescriptorPool();
+        createDescriptorSets();
+        if (config.gpuCulling) { writeCullDescriptorSet(); }
+    }
+    if (config.meshletCulling && swapChainImages.size() > meshletCommandRegions) {
+        deletionQueue.push(submittedFrame, [this, oldBuffer = meshletCommandBuffer, oldAllocation = meshletCommandAllocation]() mutable {
+            allocator.destroyBuffer(oldBuffer, oldAllocation);
+        });
+        createMeshletCommandBuffer();
+    }
+    if (config.animateInstances && swapChainImages.size() > instanceRegions) {
+        deletionQueue.push(submittedFrame, [this, oldBuffer = instanceBuffer, oldAllocation = instanceAllocation]() mutable {
+            allocator.destroyBuffer(oldBuffer, oldAllocation);
+        });
+        createAnimatedInstanceBuffer();
+    }
+    if (config.bvhCulling && !config.perFrameRecording && swapChainImages.size() > bvhCommandRegions) {
+        deletionQueue.push(submittedFrame, [this, oldBuffer = bvhCommandBuffer, oldAllocation = bvhCommandAllocation]() mutable {
+            allocator.destroyBuffer(oldBuffer, oldAllocation);
+        });
+        createBvhCommandBuffer();
+    }
+    gpuProfiler.setSlotCount(static_cast<uint32_t>(swapChainImages.size()));
     createCommandBuffers();
     createSyncObjects();
 }
 
 void VulkanApp::cleanupSwapChain() {
-    for (auto framebuffer : swapChainFramebuffers) { vkDestroyFramebuffer(device, framebuffer, nullptr); }
+    // Everything here may still be referenced by frames in flight, so it is destroyed once the last
+    // submitted frame has completed. The swapchain handle stays set: it becomes the oldSwapchain of the
+    // next createSwapChain().
+    deletionQueue.push(submittedFrame, [this, framebuffers = std::move(swapChainFramebuffers),
+                                         buffers = std::move(commandBuffers),
+                                         renderFinished = std::move(renderFinishedSemaphores),
+                                         imageAvailable = std::move(imageAvailableSemaphores),
+                                         imageViews = std::move(swapChainImageViews),
+                                         images = swapChainImages,
+                                         imageAllocations = std::move(offscreenImagesAllocation),
+                                         depthViews = std::move(depthImageViews),
+                                         depthImagesToFree = std::move(depthImages),
+                                         depthAllocations = std::move(depthImageAllocations),
+                                         oldSwapChain = swapChain]() mutable {
+        for (auto framebuffer : framebuffers) { vkDestroyFramebuffer(device, framebuffer, nullptr); }
+
+        for (size_t i = 0; i < depthImagesToFree.size(); i++) {
+            vkDestroyImageView(device, depthViews[i], nullptr);
+            allocator.destroyImage(depthImagesToFree[i], depthAllocations[i]);
+        }
 
-    // Free command buffers (they will be recreated)
-    if (!commandBuffers.empty()) {
-        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-    }
+        if (!buffers.empty()) { vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(buffers.size()), buffers.data()); }
 
-    // Destroy per-image semaphores (they will be recreated)
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-    }
+        for (size_t i = 0; i < renderFinished.size(); i++) {
+            vkDestroySemaphore(device, renderFinished[i], nullptr);
+            vkDestroySemaphore(device, imageAvailable[i], nullptr);
+        }
 
-    for (auto imageView : swapChainImageViews) { vkDestroyImageView(device, imageView, nullptr); }
+        for (auto imageView : imageViews) { vkDestroyImageView(device, imageView, nullptr); }
 
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (config.headless) {
+            // Offscreen targets are owned by us rather than by a swapchain
+            for (size_t i = 0; i < images.size(); i++) { allocator.destroyImage(images[i], imageAllocations[i]); }
+        } else {
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        }
+    });
+
+    swapChainFramebuffers.clear();
+    commandBuffers.clear();
+    renderFinishedSemaphores.clear();
+    imageAvailableSemaphores.clear();
+    swapChainImageViews.clear();
+    offscreenImagesAllocation.clear();
+    depthImageViews.clear();
+    depthImages.clear();
+    depthImageAllocations.clear();
 }
 
 // Validation layer support functions
@@ -1103,11 +2371,16 @@ bool VulkanApp::checkValidationLayerSupport() const {
 }
 
 std::vector<const char*> VulkanApp::getRequiredExtensions() const {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // Headless mode has no window, so no surface extensions are needed (and GLFW is never initialized)
+    if (!config.headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if constexpr (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
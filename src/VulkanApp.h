@@ -12,9 +12,30 @@
 #include <vector>
 #include <optional>
 #include <chrono>
+#include <string>
 
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshGenerator.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshWelder.h"
+#include "Instancing.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "Scene.h"
+#include "Meshlet.h"
+#include "MemoryAllocator.h"
+#include "DeletionQueue.h"
+#include "UniformRing.h"
+#include "UploadManager.h"
 #include "VulkanException.h"
+#include "FrameBenchmark.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include "TaskGraph.h"
+#include "WorkerPool.h"
 
 // Enable validation layers in debug builds
 #ifdef NDEBUG
@@ -26,6 +47,8 @@
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Transfer-only family (no graphics/compute) used for uploads when the device has one
+    std::optional<uint32_t> transferFamily;
 
     [[nodiscard]] bool isComplete() const {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -53,41 +76,184 @@ struct LightingBufferObject {
     float specularStrength;
 };
 
+// Inputs of the GPU culling pass (cull.comp)
+struct CullBufferObject {
+    glm::vec4 planes[6];
+    // Mesh-space bounding sphere: center in xyz, radius in w
+    glm::vec4 boundingSphere;
+    uint32_t instanceCount;
+};
+
+// Written by the GPU culling pass: the draw count precedes the one indirect command, so both the plain and
+// the count variant of vkCmdDrawIndexedIndirect read from the same buffer
+struct GpuDrawCommands {
+    uint32_t drawCount;
+    uint32_t padding[3];
+    VkDrawIndexedIndirectCommand command;
+};
+
+// Geometry the app renders
+enum class MeshShape {
+    Cube,
+    Grid,
+    UvSphere,
+    IcoSphere,
+    Torus,
+    Cylinder,
+};
+
+struct AppConfig {
+    // Render into offscreen images instead of a GLFW window + swapchain
+    bool headless = false;
+    uint32_t width = 800;
+    uint32_t height = 600;
+    // Threads used to overlap independent init steps (0 = hardware concurrency, 1 = serial)
+    uint32_t initThreads = 0;
+    // Number of frames to render before exiting (0 = until the window is closed)
+    uint32_t frameCount = 0;
+    // Headless only: write the last rendered frame to this PPM file
+    std::string outputImage;
+
+    // Benchmark mode: frameCount frames are measured after warmupFrames unmeasured ones
+    bool benchmark = false;
+    uint32_t warmupFrames = 100;
+    std::string benchmarkOutput = "benchmark.json";
+
+    // Wrap the render pass and draws in GPU timestamp queries
+    bool gpuProfile = false;
+
+    // Rendered geometry; every shape but the cube is tessellated with meshSegments segments around
+    // (ico spheres use it as the subdivision frequency)
+    MeshShape meshShape = MeshShape::Cube;
+    uint32_t meshSegments = 64;
+    // Load this OBJ or GLB file instead of generating meshShape
+    std::string meshFile;
+    // Convert meshFile to a binary cache next to it (<file>.meshcache) on first use and load that afterwards
+    bool meshCache = true;
+    // Merge vertices whose positions differ by at most weldEpsilon per axis (and whose normals and UVs
+    // match closely) before optimization
+    bool weldVertices = true;
+    float weldEpsilon = 1e-5f;
+    // Reorder mesh triangles and vertices for vertex cache, overdraw and fetch before upload
+    bool optimizeMeshes = true;
+    // Generate simplified levels of detail and draw the coarsest one whose projected error stays below
+    // lodPixelError pixels
+    bool buildLods = true;
+    float lodPixelError = 1.0f;
+    // Split meshes into meshlets, cull them against the frustum and their normal cones on the CPU every
+    // frame and draw the survivors with indirect draws
+    bool meshletCulling = false;
+    // Upload meshes as 16-byte PackedVertex instead of 32-byte Vertex
+    bool packedVertices = false;
+    // Upload positions and the remaining attributes as separate vertex streams (float format only)
+    bool splitVertexStreams = false;
+    // Lay down depth with a position-only pipeline first, so the Phong fragment shader runs at most once
+    // per pixel (the color pass then only passes fragments with exactly the prepass depth)
+    bool depthPrepass = false;
+    // Copies of the mesh drawn with one instanced draw, laid out on a grid filling the mesh's place
+    uint32_t instanceCount = 1;
+    // Benchmark 1, 10, 100, ... up to instanceCount instances in one run, one result file per step
+    bool instanceSweep = false;
+    // Frustum-cull instances in a compute pass that compacts the visible ones and writes the indirect draw,
+    // so the recorded command buffers never change with visibility
+    bool gpuCulling = false;
+    // Frustum-cull instances on the CPU against a BVH every frame and draw the visible runs of instances
+    // with indirect draws
+    bool bvhCulling = false;
+    // Turn every instance about its own axis through the scene hierarchy each frame and upload the new
+    // transforms into a per-image region of the instance buffer (refitting the BVH with --bvh-culling)
+    bool animateInstances = false;
+    // Record a fresh command buffer every frame instead of replaying prerecorded ones: worker threads
+    // record the draws into secondary command buffers that the frame's primary executes
+    bool perFrameRecording = false;
+    // Recording threads with perFrameRecording (0 = hardware concurrency)
+    uint32_t recordThreads = 0;
+
+    // Record CPU trace zones and write them as Chrome trace JSON on exit (requires ENABLE_TRACING)
+    std::string traceOutput;
+    // Also dump the trace whenever a frame takes longer than this many milliseconds (0 = off)
+    double traceStallMs = 0.0;
+};
+
 class VulkanApp {
 public:
+    explicit VulkanApp(const AppConfig& appConfig = AppConfig{});
+
     void run();
 
 private:
+    AppConfig config;
+
     // Window settings
-    const uint32_t WIDTH = 800;
-    const uint32_t HEIGHT = 600;
     const char* WINDOW_TITLE = "Vulkan App";
     bool framebufferResized = false;
+    // Framebuffer size, queried on the main thread (GLFW requirement) for swapchain creation on any thread
+    VkExtent2D framebufferExtent = {0, 0};
+
+    // Frames rendered in headless mode when no explicit frame count is given
+    const uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+    // Measured frames in benchmark mode when no explicit frame count is given
+    const uint32_t DEFAULT_BENCHMARK_FRAME_COUNT = 1000;
+    // Upper bound on init threads when none are requested; the init graph is never wider than this
+    const uint32_t MAX_INIT_THREADS = 4;
 
     // Validation layers
     const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
     
     // Vulkan components
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
     VkInstance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+
+    // Sub-allocates all buffer and image memory from large blocks
+    DeviceAllocator allocator;
+    // Batches staging copies, on the transfer queue when there is one
+    UploadManager uploadManager;
+    const VkDeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
 
-    // Swap chain
-    VkSwapchainKHR swapChain;
+    // Swap chain (in headless mode swapChainImages holds the offscreen render targets)
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
+    VkSurfaceFormatKHR surfaceFormat;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
+    VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
     std::vector<VkImageView> swapChainImageViews;
 
+    // Offscreen render targets (headless mode)
+    std::vector<Allocation> offscreenImagesAllocation;
+
+    // Depth buffers, one per swapchain image like the framebuffers that use them
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    std::vector<VkImage> depthImages;
+    std::vector<Allocation> depthImageAllocations;
+    std::vector<VkImageView> depthImageViews;
+
     // Pipeline
     VkPipeline graphicsPipeline;
+    // Position-only, depth-writing pipeline of the depth prepass (shares pipelineLayout)
+    VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout;
     VkRenderPass renderPass;
+    // SPIR-V read ahead of pipeline creation, released once the pipeline exists
+    std::vector<char> vertShaderCode;
+    std::vector<char> fragShaderCode;
+    std::vector<char> depthVertShaderCode;
+    std::vector<char> cullShaderCode;
+
+    // GPU culling compute pass, with its own set: cull uniforms, all instances, visible instances, draw commands
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+    // vkCmdDrawIndexedIndirectCountKHR when VK_KHR_draw_indirect_count is available
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
 
     // Framebuffers
     std::vector<VkFramebuffer> swapChainFramebuffers;
@@ -106,22 +272,121 @@ private:
     // Per-image synchronization (for proper swapchain image handling)
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
+    // Fence of the frame that last submitted each image's command buffer
+    std::vector<VkFence> imagesInFlight;
+
+    // Frames are numbered from 1 in submission order; each in-flight fence remembers the last frame it guarded
+    uint64_t submittedFrame = 0;
+    std::vector<uint64_t> inFlightFrameNumbers;
+    // Objects retired while frames may still use them, destroyed once those frames have completed
+    DeletionQueue deletionQueue;
+
+    // GPU timestamp profiling (one query pool slot per command buffer)
+    GpuProfiler gpuProfiler;
 
     // Cube mesh
     Mesh cubeMesh;
 
-    // Uniform buffers
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
-    std::vector<VkBuffer> lightingBuffers;
-    std::vector<VkDeviceMemory> lightingBuffersMemory;
+    // Per-frame uniform data, sub-allocated from one persistently mapped ring
+    struct FrameUniforms {
+        UniformSlice transforms;
+        UniformSlice lighting;
+        // Only allocated with GPU culling
+        UniformSlice cull;
+    };
+    UniformRing uniformRing;
+    // Uniform bytes available to each frame
+    const VkDeviceSize UNIFORM_RING_REGION_SIZE = 64 * 1024;
+    // Octahedral normals in 2x16 bits stay well below this; more means the encoding is broken
+    const float MAX_NORMAL_QUANTIZATION_DEGREES = 0.01f;
+
+    // Meshlet culling: one region of indirect draws per swapchain image, each holding a command per
+    // meshlet of the mesh (indexed like Mesh::meshlets), rewritten by updateUniformBuffer()
+    VkBuffer meshletCommandBuffer = VK_NULL_HANDLE;
+    Allocation meshletCommandAllocation;
+    uint32_t meshletCommandRegions = 0;
+    // Commands per vkCmdDrawIndexedIndirect call: 1 unless multiDrawIndirect is enabled
+    uint32_t maxDrawIndirectCount = 1;
+    // Per-instance transforms and materials (InstanceData), read at instance rate from binding 2. With
+    // animated instances it is host visible and holds one region of drawInstanceCount instances per
+    // swapchain image, rewritten by updateUniformBuffer().
+    VkBuffer instanceBuffer = VK_NULL_HANDLE;
+    Allocation instanceAllocation;
+    uint32_t instanceRegions = 1;
+    uint32_t drawInstanceCount = 1;
+    // Size of one instance relative to the whole grid, which scales its projected LOD error
+    float instanceScale = 1.0f;
+    // GPU culling output: the visible instances (drawn from binding 2 instead of instanceBuffer) and the
+    // GpuDrawCommands. Shared by all swapchain images; barriers order each frame after the previous one.
+    VkBuffer visibleInstanceBuffer = VK_NULL_HANDLE;
+    Allocation visibleInstanceAllocation;
+    VkBuffer drawCommandBuffer = VK_NULL_HANDLE;
+    Allocation drawCommandAllocation;
+    // BVH culling: the instance buffer is in BVH order, so visible instances form ranges drawn through
+    // firstInstance. One region per swapchain image, holding the draw count (padded to
+    // BVH_COMMAND_HEADER_SIZE) and MAX_BVH_DRAW_RANGES commands, rewritten by updateUniformBuffer().
+    Bvh instanceBvh;
+    std::vector<BvhRange> visibleRanges;
+    VkBuffer bvhCommandBuffer = VK_NULL_HANDLE;
+    Allocation bvhCommandAllocation;
+    uint32_t bvhCommandRegions = 0;
+    // Commands written into each region last time, so stale ones can be cleared
+    std::vector<uint32_t> bvhRegionDrawCounts;
+    BvhCullStats bvhCullTotals;
+    uint64_t bvhCullFrames = 0;
+    // Past this many ranges the BVH merges them, drawing some culled instances
+    const uint32_t MAX_BVH_DRAW_RANGES = 4096;
+    const VkDeviceSize BVH_COMMAND_HEADER_SIZE = 16;
+    // Matches local_size_x in cull.comp
+    const uint32_t CULL_GROUP_SIZE = 64;
+
+    // Transform hierarchy: the spinning mesh, and with animated instances a root holding one node per
+    // instance (in instance buffer order). Instances keep the transforms they were built with in
+    // animatedInstances and turn about their own axis from there.
+    Scene scene;
+    SceneNode spinNode = 0;
+    std::vector<SceneNode> instanceNodes;
+    std::vector<InstanceData> animatedInstances;
+    // Bounds of the animated instances in the order the BVH was built from
+    std::vector<ObjectBounds> animatedBounds;
+
+    // Persistent threads for per-frame work: recording, the scene update and the animated instances.
+    // Started with the frame recorders, or on their own when only the instances are animated; until
+    // then the work runs on the calling thread.
+    WorkerPool frameWorkers;
+
+    // Per-frame recording: a pool per frame in flight for the primary and one per frameWorkers worker
+    // for its secondaries, so no pool is ever touched by two threads and each frame resets only its own pools
+    struct RecordWorker {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer prepass = VK_NULL_HANDLE;
+        VkCommandBuffer color = VK_NULL_HANDLE;
+    };
+    struct FrameRecorder {
+        VkCommandPool primaryPool = VK_NULL_HANDLE;
+        VkCommandBuffer primary = VK_NULL_HANDLE;
+        std::vector<RecordWorker> workers;
+        // Secondaries handed to vkCmdExecuteCommands, kept to avoid a per-frame allocation
+        std::vector<VkCommandBuffer> executed;
+    };
+    std::vector<FrameRecorder> frameRecorders;
+    // Smallest draw list worth handing to another recording thread
+    const uint32_t MIN_DRAWS_PER_RECORD_THREAD = 256;
+
+    // Level of detail baked into the command buffers; culling only rewrites its meshlets
+    MeshLod drawLod;
+    MeshletCullStats meshletCullTotals;
 
     // Descriptor sets
     VkDescriptorPool descriptorPool;
     VkDescriptorSetLayout descriptorSetLayout;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkDescriptorSet descriptorSet;
+
+    // Timings of the most recent drawFrame() call
+    FrameTimings frameTimings;
 
     // Camera
+    const float CAMERA_FOV_DEGREES = 45.0f;
     glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 2.0f);
     glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
     glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -130,6 +395,9 @@ private:
     void initWindow();
     void initVulkan();
     void mainLoop();
+    // Renders until targetFrames (0 = until the window closes); returns the number of frames rendered
+    uint32_t renderFrames(uint32_t targetFrames, FrameBenchmark* benchmark);
+    uint32_t runInstanceSweep();
     void cleanup();
 
     // Vulkan setup functions
@@ -155,25 +423,66 @@ private:
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createSwapChain();
+    void chooseSurfaceFormat();
+    void createOffscreenTargets();
     void createImageViews();
     void createRenderPass();
+    void createDepthResources();
     void createDescriptorSetLayout();
+    void loadShaderCode();
     void createGraphicsPipeline();
+    void createCullPipeline();
     void createFramebuffers();
     void createCommandPool();
+    void createUploadManager();
+    Mesh generateShape() const;
+    Mesh loadMeshFile() const;
+    uint32_t meshCacheOptions() const;
+    void generateCubeMesh();
     void createCubeMesh();
-    void createUniformBuffers();
+    void createUniformRing();
+    void createMeshletCommandBuffer();
+    void createBvhCommandBuffer();
+    VkDeviceSize bvhCommandRegionSize() const;
+    void createInstanceBuffer(uint32_t count);
+    // Host-visible instance buffer with a region per swapchain image, each starting from animatedInstances
+    void createAnimatedInstanceBuffer();
+    void buildScene();
+    // Sized for the current instance count; also points the cull descriptor set at them
+    void createCullBuffers();
+    void writeCullDescriptorSet();
+    // Replaces the instance buffer and re-records the command buffers; waits for the device to go idle
+    void setInstanceCount(uint32_t count);
     void createDescriptorPool();
     void createDescriptorSets();
     void createCommandBuffers();
+    void createFrameRecorders();
+    void beginRenderPass(VkCommandBuffer commandBuffer, size_t imageIndex, VkSubpassContents contents) const;
+    // Viewport, scissor, vertex/index buffers, descriptor sets and push constants shared by every draw
+    void recordDrawState(VkCommandBuffer commandBuffer, size_t imageIndex, const FrameUniforms& uniforms) const;
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t cullOffset);
+    void recordMeshDraw(VkCommandBuffer commandBuffer, size_t imageIndex) const;
+    // Per-frame recording: records this frame's primary command buffer and returns it
+    VkCommandBuffer recordFrame(uint32_t imageIndex);
+    // Records draws [firstDraw, endDraw) of the frame's draw list into the worker's secondaries
+    void recordSecondaries(RecordWorker& worker, uint32_t imageIndex, const FrameUniforms& uniforms,
+                           uint32_t firstDraw, uint32_t endDraw) const;
     void createSyncObjects();
 
     // Draw and update functions
-    void drawFrame();
+    // Returns false when the swapchain was out of date and no image was presented
+    bool drawFrame();
     void updateUniformBuffer(uint32_t currentImage);
+    // Sets the instances' local transforms for time; scene.update() then propagates them
+    void animateInstances(float time);
+    // Writes the updated instance transforms into the image's region and refits the BVH over them
+    void uploadAnimatedInstances(uint32_t currentImage);
+    FrameUniforms allocateFrameUniforms(uint32_t imageIndex);
+    void saveOffscreenImage(uint32_t imageIndex, const std::string& filename);
 
     // Helper functions
     std::vector<char> readFile(const std::string& filename);
+    VkFormat findDepthFormat() const;
     bool isDeviceSuitable(VkPhysicalDevice physicalDev);
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDev);
     bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDev);
@@ -181,8 +490,8 @@ private:
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+    BenchmarkInfo describeBenchmark() const;
     VkShaderModule createShaderModule(const std::vector<char>& code);
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     void recreateSwapChain();
     void cleanupSwapChain();
 };
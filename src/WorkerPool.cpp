@@ -0,0 +1,79 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void WorkerPool::start(uint32_t threadCount) {
+    if (!threads.empty()) { throw std::runtime_error("worker pool is already started!"); }
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+    stopping = false;
+    threads.reserve(threadCount - 1);
+    for (uint32_t worker = 1; worker < threadCount; worker++) { threads.emplace_back(&WorkerPool::workerLoop, this, worker); }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) { thread.join(); }
+    threads.clear();
+}
+
+void WorkerPool::run(uint32_t workerCount, const std::function<void(uint32_t worker)>& body) {
+    if (workerCount == 0) { return; }
+    if (workerCount > getWorkerCount()) { throw std::runtime_error("worker pool has fewer workers than requested!"); }
+
+    if (workerCount > 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &body;
+            jobWorkers = workerCount;
+            pending = workerCount - 1;
+            failure = nullptr;
+            generation++;
+        }
+        wake.notify_all();
+    }
+
+    std::exception_ptr callerFailure;
+    try {
+        body(0);
+    } catch (...) {
+        callerFailure = std::current_exception();
+    }
+
+    if (workerCount > 1) {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return pending == 0; });
+        job = nullptr;
+        if (!callerFailure) { callerFailure = failure; }
+    }
+    if (callerFailure) { std::rethrow_exception(callerFailure); }
+}
+
+void WorkerPool::workerLoop(uint32_t worker) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Jobs from before a restart are done; only wake for the next one
+    uint64_t seenGeneration = generation;
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+        if (stopping) { return; }
+        seenGeneration = generation;
+        // Workers past the job's count may sleep through it; run() only waits for the ones it uses
+        if (worker >= jobWorkers) { continue; }
+
+        const std::function<void(uint32_t)>* body = job;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            (*body)(worker);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (error && !failure) { failure = error; }
+        if (--pending == 0) { finished.notify_one(); }
+    }
+}
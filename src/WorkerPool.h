@@ -0,0 +1,54 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for work that runs every frame, where creating threads per call would cost
+// more than the work itself. Worker 0 is whichever thread calls run(); workers 1..n-1 are threads owned
+// by the pool, so a worker index always maps to the same thread and per-worker state (such as a command
+// pool) is only ever touched by that thread. Not reentrant: run() must not be called from inside a job,
+// or from two threads at once.
+class WorkerPool {
+public:
+    WorkerPool() = default;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool() { stop(); }
+
+    // Starts threadCount - 1 threads (0 = hardware concurrency); throws if already started
+    void start(uint32_t threadCount);
+    // Joins the threads; the pool can be started again afterwards
+    void stop();
+
+    // 1 until started
+    [[nodiscard]] uint32_t getWorkerCount() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+    // Runs body(worker) once for each worker in [0, workerCount) and returns when all have finished. The
+    // first exception thrown by body is rethrown then.
+    void run(uint32_t workerCount, const std::function<void(uint32_t worker)>& body);
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    // The current job, published under mutex; each run() bumps generation to wake the workers
+    const std::function<void(uint32_t)>* job = nullptr;
+    uint32_t jobWorkers = 0;
+    uint64_t generation = 0;
+    // Pool threads still running the current job
+    uint32_t pending = 0;
+    std::exception_ptr failure;
+    bool stopping = false;
+
+    void workerLoop(uint32_t worker);
+};
+
+#endif // WORKER_POOL_H
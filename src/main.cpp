@@ -2,9 +2,153 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <string>
 
-int main() {
-    VulkanApp app;
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --headless           Render offscreen without a window (e.g. on lavapipe)\n"
+              << "  --width <pixels>     Render target width (default 800)\n"
+              << "  --height <pixels>    Render target height (default 600)\n"
+              << "  --frames <count>     Exit after rendering this many frames (measured frames with --benchmark)\n"
+              << "  --output <file.ppm>  Headless only: save the last frame as a PPM image\n"
+              << "  --benchmark          Measure frame times and write percentiles as JSON\n"
+              << "  --warmup <count>     Benchmark warm-up frames excluded from results (default 100)\n"
+              << "  --benchmark-output <file.json>  Benchmark results file (default benchmark.json)\n"
+              << "  --gpu-profile        Measure GPU time per render pass/draw with timestamp queries\n"
+              << "  --mesh <shape>       cube (default), grid, uvsphere, icosphere, torus or cylinder\n"
+              << "  --mesh-segments <n>  Tessellation of generated shapes (default 64, at least 3)\n"
+              << "  --mesh-file <file>   Load an OBJ or GLB mesh instead of a generated shape\n"
+              << "  --no-mesh-cache      Always re-import --mesh-file instead of using <file>.meshcache\n"
+              << "  --no-weld            Keep duplicate vertices instead of welding them\n"
+              << "  --weld-epsilon <e>   Position tolerance for welding, after scaling to unit size (default 1e-5, 0 = exact)\n"
+              << "  --no-mesh-optimize   Upload meshes in authoring order (skip cache/overdraw/fetch optimization)\n"
+              << "  --no-lods            Do not generate simplified levels of detail\n"
+              << "  --lod-pixel-error <px>  Largest projected LOD error in pixels (default 1)\n"
+              << "  --packed-vertices    Use 16-byte quantized vertices (unorm16 position, octahedral normal, half UV)\n"
+              << "  --meshlet-culling    Cull meshlets on the CPU each frame and draw them indirectly\n"
+              << "  --split-streams      Upload positions and other attributes as separate vertex streams\n"
+              << "  --depth-prepass      Render depth with a position-only pipeline before shading\n"
+              << "  --instances <n>      Draw n copies of the mesh on a grid with one instanced draw (default 1)\n"
+              << "  --instance-sweep     With --benchmark: measure 1, 10, 100, ... up to --instances (default 1000000)\n"
+              << "  --gpu-culling        Frustum-cull instances in a compute pass and draw the survivors indirectly\n"
+              << "  --bvh-culling        Frustum-cull instances on the CPU against a BVH and draw the visible ranges indirectly\n"
+              << "  --animate-instances  Spin every instance through the scene hierarchy and re-upload them each frame\n"
+              << "  --record-per-frame   Record the frame's commands every frame, in secondary command buffers on worker threads\n"
+              << "  --record-threads <n> Worker threads for --record-per-frame (default: hardware concurrency)\n"
+              << "  --init-threads <n>   Threads for Vulkan initialization (default: up to 4, 1 = serial)\n"
+              << "  --trace <file.json>  Record CPU trace zones and write a Chrome/Perfetto trace on exit\n"
+              << "  --trace-stall-ms <ms>  With --trace, also dump <file>_stall_<frame>.json when a frame exceeds this time\n"
+              << "  --help               Show this message" << std::endl;
+}
+
+static uint32_t parseCount(const std::string& option, const char* value) {
+    try {
+        unsigned long parsed = std::stoul(value);
+        return static_cast<uint32_t>(parsed);
+    } catch (const std::exception&) {
+        throw std::runtime_error("invalid value for " + option + ": " + value);
+    }
+}
+
+static double parseNumber(const std::string& option, const char* value) {
+    try {
+        return std::stod(value);
+    } catch (const std::exception&) {
+        throw std::runtime_error("invalid value for " + option + ": " + value);
+    }
+}
+
+static MeshShape parseMeshShape(const std::string& option, const std::string& value) {
+    if (value == "cube") { return MeshShape::Cube; }
+    if (value == "grid") { return MeshShape::Grid; }
+    if (value == "uvsphere") { return MeshShape::UvSphere; }
+    if (value == "icosphere") { return MeshShape::IcoSphere; }
+    if (value == "torus") { return MeshShape::Torus; }
+    if (value == "cylinder") { return MeshShape::Cylinder; }
+    throw std::runtime_error("invalid value for " + option + ": " + value);
+}
+
+static bool parseArguments(int argc, char* argv[], AppConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto nextValue = [&]() -> const char* {
+            if (i + 1 >= argc) { throw std::runtime_error("missing value for " + arg); }
+            return argv[++i];
+        };
+
+        if (arg == "--headless") { config.headless = true; }
+        else if (arg == "--width") { config.width = parseCount(arg, nextValue()); }
+        else if (arg == "--height") { config.height = parseCount(arg, nextValue()); }
+        else if (arg == "--frames") { config.frameCount = parseCount(arg, nextValue()); }
+        else if (arg == "--output") { config.outputImage = nextValue(); }
+        else if (arg == "--benchmark") { config.benchmark = true; }
+        else if (arg == "--warmup") { config.warmupFrames = parseCount(arg, nextValue()); }
+        else if (arg == "--benchmark-output") { config.benchmarkOutput = nextValue(); }
+        else if (arg == "--gpu-profile") { config.gpuProfile = true; }
+        else if (arg == "--mesh") { config.meshShape = parseMeshShape(arg, nextValue()); }
+        else if (arg == "--mesh-segments") { config.meshSegments = parseCount(arg, nextValue()); }
+        else if (arg == "--mesh-file") { config.meshFile = nextValue(); }
+        else if (arg == "--no-mesh-cache") { config.meshCache = false; }
+        else if (arg == "--no-weld") { config.weldVertices = false; }
+        else if (arg == "--weld-epsilon") { config.weldEpsilon = static_cast<float>(parseNumber(arg, nextValue())); }
+        else if (arg == "--no-mesh-optimize") { config.optimizeMeshes = false; }
+        else if (arg == "--no-lods") { config.buildLods = false; }
+        else if (arg == "--lod-pixel-error") { config.lodPixelError = static_cast<float>(parseNumber(arg, nextValue())); }
+        else if (arg == "--packed-vertices") { config.packedVertices = true; }
+        else if (arg == "--meshlet-culling") { config.meshletCulling = true; }
+        else if (arg == "--split-streams") { config.splitVertexStreams = true; }
+        else if (arg == "--depth-prepass") { config.depthPrepass = true; }
+        else if (arg == "--instances") { config.instanceCount = parseCount(arg, nextValue()); }
+        else if (arg == "--instance-sweep") { config.instanceSweep = true; }
+        else if (arg == "--gpu-culling") { config.gpuCulling = true; }
+        else if (arg == "--bvh-culling") { config.bvhCulling = true; }
+        else if (arg == "--animate-instances") { config.animateInstances = true; }
+        else if (arg == "--record-per-frame") { config.perFrameRecording = true; }
+        else if (arg == "--record-threads") { config.recordThreads = parseCount(arg, nextValue()); }
+        else if (arg == "--init-threads") { config.initThreads = parseCount(arg, nextValue()); }
+        else if (arg == "--trace") { config.traceOutput = nextValue(); }
+        else if (arg == "--trace-stall-ms") { config.traceStallMs = parseNumber(arg, nextValue()); }
+        else if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return false; }
+        else { throw std::runtime_error("unknown option: " + arg); }
+    }
+
+    if (config.width == 0 || config.height == 0) { throw std::runtime_error("render target size must be non-zero"); }
+    if (!config.outputImage.empty() && !config.headless) { throw std::runtime_error("--output requires --headless"); }
+    if (config.meshSegments < 3) { throw std::runtime_error("--mesh-segments must be at least 3"); }
+    if (config.weldEpsilon < 0.0f) { throw std::runtime_error("--weld-epsilon must not be negative"); }
+    if (config.instanceCount == 0) { throw std::runtime_error("--instances must be at least 1"); }
+    if (config.instanceSweep && !config.benchmark) { throw std::runtime_error("--instance-sweep requires --benchmark"); }
+    if (config.instanceSweep && config.instanceCount == 1) { config.instanceCount = 1000000; }
+    // Culled meshlet commands are written for a single instance
+    if (config.meshletCulling && (config.instanceCount > 1 || config.instanceSweep)) {
+        throw std::runtime_error("--meshlet-culling cannot be combined with --instances or --instance-sweep");
+    }
+    if (config.meshletCulling + config.gpuCulling + config.bvhCulling > 1) {
+        throw std::runtime_error("only one of --meshlet-culling, --gpu-culling and --bvh-culling can be used");
+    }
+    // The cull pass reads one fixed instance buffer, animated instances live in per-image regions
+    if (config.animateInstances && config.gpuCulling) { throw std::runtime_error("--animate-instances cannot be combined with --gpu-culling"); }
+    if (config.recordThreads != 0 && !config.perFrameRecording) { throw std::runtime_error("--record-threads requires --record-per-frame"); }
+    if (config.splitVertexStreams && config.packedVertices) { throw std::runtime_error("--split-streams cannot be combined with --packed-vertices"); }
+#ifndef ENABLE_TRACING
+    if (!config.traceOutput.empty()) { std::cerr << "Warning: built without ENABLE_TRACING, the trace will be empty" << std::endl; }
+#endif
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    AppConfig config;
+
+    try {
+        if (!parseArguments(argc, argv, config)) { return EXIT_SUCCESS; }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    VulkanApp app(config);
 
     try {
         app.run();
@@ -14,4 +158,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}